@@ -0,0 +1,252 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Batch.h"
+#include "Files.h"
+#include "OutputSink.h"
+
+#include <algorithm>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// One queue of jobs per thread, each starting with a contiguous block of the
+// manifest. A thread takes jobs from the front of its own queue and, once it
+// is empty, steals them from the back of the others.
+class JobQueues{
+public:
+    JobQueues(std::size_t count, std::size_t threads):
+    queues(threads){
+        for (std::size_t i = 0; i < threads; ++i){
+            std::size_t first = count * i / threads;
+            std::size_t last = count * (i + 1) / threads;
+            for (std::size_t job = first; job < last; ++job)
+                queues[i].jobs.push_back(job);
+        }
+    }
+
+    // false when there is nothing left anywhere (no job is ever added)
+    bool next(std::size_t thread, std::size_t &job){
+        for (std::size_t i = 0; i < queues.size(); ++i){
+            Queue &queue = queues[(thread + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.jobs.empty())
+                continue;
+
+            if (i == 0){
+                job = queue.jobs.front();
+                queue.jobs.pop_front();
+            } else{
+                job = queue.jobs.back();
+                queue.jobs.pop_back();
+            }
+            return true;
+        }
+        return false;
+    }
+
+private:
+    struct Queue{
+        std::mutex mutex;
+        std::deque<std::size_t> jobs;
+    };
+
+    std::vector<Queue> queues;
+};
+
+}
+
+Batch::Batch(const Settings &settings):
+settings(settings){
+}
+
+// reads the manifest and loads every program in it, once
+bool Batch::load(const std::string &manifest){
+    std::ifstream file(manifest.c_str());
+    if (!file){
+        message = "The manifest could not be opened (" + manifest + ")";
+        return false;
+    }
+
+    std::map<std::string, std::size_t> loaded;
+    std::string line;
+    for (std::size_t number = 1; std::getline(file, line); ++number){
+        std::istringstream fields(line);
+        std::string program;
+        Job job;
+        if (!(fields >> program) || (program[0] == '#'))
+            continue;
+        if (!(fields >> job.input)){
+            message = "The manifest has no input file in line " + std::to_string(number);
+            return false;
+        }
+        fields >> job.output;
+
+        auto found = loaded.find(program);
+        if (found == loaded.end()){
+            Interpreter interpreter;
+            Loaded entry;
+            entry.path = program;
+            if (interpreter.load(program))
+                entry.program = interpreter.program();
+            else
+                entry.error = interpreter.lastError();
+
+            found = loaded.emplace(program, programs.size()).first;
+            programs.push_back(std::move(entry));
+        }
+
+        job.program = found->second;
+        jobs.push_back(std::move(job));
+    }
+
+    return true;
+}
+
+const std::string &Batch::error() const{
+    return message;
+}
+
+int Batch::run(){
+    std::size_t threads = settings.threads ? settings.threads : std::thread::hardware_concurrency();
+    threads = std::max<std::size_t>(1, std::min(threads, jobs.size()));
+
+    std::vector<Result> results(jobs.size());
+    JobQueues queues(jobs.size(), threads);
+
+    // whoever finishes the job that is next in order writes it, and any
+    // finished ones after it
+    OutputSink out(1);
+    OutputSink report(2);
+    std::mutex order;
+    std::size_t written = 0;
+    int status = 0;
+
+    auto work = [&](std::size_t thread){
+        std::size_t index;
+        while (queues.next(thread, index)){
+            Result result;
+            runJob(index, result);
+
+            std::lock_guard<std::mutex> lock(order);
+            results[index] = std::move(result);
+            results[index].done = true;
+            for (; (written < results.size()) && results[written].done; ++written){
+                const Job &job = jobs[written];
+                Result &finished = results[written];
+                out.write(finished.output);
+                report.write(programs[job.program].path + "\t" + job.input + "\t" +
+                             std::to_string(finished.status) + "\t" + finished.error + "\n");
+                status = std::max(status, finished.status);
+                finished = Result();
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (std::size_t i = 1; i < threads; ++i)
+        pool.emplace_back(work, i);
+    work(0);
+    for (auto &thread : pool)
+        thread.join();
+
+    return status;
+}
+
+// the exit status is the one dstack gives for a single run
+void Batch::runJob(std::size_t index, Result &result) const{
+    const Job &job = jobs[index];
+    const Loaded &loaded = programs[job.program];
+    if (!loaded.program){
+        result.status = 2;
+        result.error = loaded.error;
+        return;
+    }
+
+    std::string input;
+    if (!readFile(job.input, input)){
+        result.status = 2;
+        result.error = "The file could not be opened (" + job.input + ")";
+        return;
+    }
+
+    // only the output that has to come out in order is kept in memory;
+    // a job with a file writes straight to it
+    int fd = -1;
+    if (!job.output.empty()){
+#ifdef _WIN32
+        fd = _open(job.output.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+#else
+        fd = ::open(job.output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+        if (fd < 0){
+            result.status = 2;
+            result.error = "The output could not be written (" + job.output + ")";
+            return;
+        }
+    }
+
+    std::string output;
+    Interpreter interpreter;
+    interpreter.setProgram(loaded.program);
+    interpreter.setEngine(settings.engine);
+    interpreter.setLimits(settings.limits);
+    interpreter.setRandom(settings.generator, settings.seed + index);
+    interpreter.setInput(std::string_view(input));
+    if (fd >= 0){
+        interpreter.setOutput(fd);
+    } else{
+        interpreter.setOutput([&output](const char *data, std::size_t size){
+            output.append(data, size);
+        });
+    }
+
+    if (!interpreter.execute()){
+        result.status = interpreter.limitReached() ? 4 : 3;
+        result.error = interpreter.lastError();
+    }
+
+    if (fd < 0){
+        result.output = std::move(output);
+        return;
+    }
+
+#ifdef _WIN32
+    bool closed = _close(fd) == 0;
+#else
+    bool closed = ::close(fd) == 0;
+#endif
+    if (interpreter.outputFailed() || !closed){
+        result.status = std::max(result.status, 2);
+        result.error = "The output could not be written (" + job.output + ")";
+    }
+}
@@ -0,0 +1,87 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "Interpreter.h"
+#include "Number.h"
+#include "Program.h"
+#include "Random.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// dstack --batch: runs many program/input pairs listed in a manifest, one
+// per line:
+//
+//     program input [output]
+//
+// Blank lines and lines starting with # are skipped. Every program is loaded
+// once and shared by all its jobs; the jobs run on a pool of threads, each
+// with its own interpreter (stacks, I/O buffers and generator). A job without
+// an output file writes to the standard output. Those outputs, and a line per
+// job with its exit status on the standard error, come out in the order of
+// the manifest, whatever order the jobs finish in.
+class Batch{
+public:
+    struct Settings{
+        Engine engine = Engine::Switch;
+        Limits limits;
+        Random::Generator generator = Random::Generator::Xoshiro;
+        Number seed = 0;                // job n (from 0) uses seed + n
+        unsigned int threads = 0;       // 0 for one per core
+    };
+
+    explicit Batch(const Settings &settings);
+
+    bool load(const std::string &manifest);
+    const std::string &error() const;
+
+    // the highest exit status of any job
+    int run();
+
+private:
+    struct Job{
+        std::size_t program;
+        std::string input;
+        std::string output;
+    };
+
+    struct Loaded{
+        std::string path;
+        std::shared_ptr<const Program> program;     // null if it didn't load
+        std::string error;
+    };
+
+    struct Result{
+        int status = 0;
+        std::string output;
+        std::string error;
+        bool done = false;
+    };
+
+    void runJob(std::size_t index, Result &result) const;
+
+    Settings settings;
+    std::vector<Job> jobs;
+    std::vector<Loaded> programs;
+    std::string message;
+};
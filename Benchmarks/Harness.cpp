@@ -0,0 +1,277 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+// Runs every benchmark of a directory under every engine and writes one CSV
+// row per run:
+//
+//     dstack-bench path/to/dstack Benchmarks [repetitions] [output.csv]
+//
+// A benchmark is a .dstck file, with an optional .in file for its standard
+// input and an optional .expected file with the size and the FNV-1a hash of
+// its output ("<bytes> <hash in hex>"). Each run is a separate process, so
+// the peak RSS is its own; the best wall time of the repetitions is kept.
+//
+// One more benchmark, "parse", is generated: several megabytes of code,
+// comments and string literals behind a Halt, so only loading it counts.
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+struct Run{
+    bool finished;
+    double seconds;             // the whole process
+    double loadSeconds;         // what dstack --stats measured
+    double executeSeconds;
+    std::uint64_t instructions;
+    long peakKilobytes;
+    std::uint64_t outputSize;
+    std::uint64_t outputHash;
+};
+
+std::string readFile(const std::string &path){
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+void hashFile(const std::string &path, std::uint64_t &size, std::uint64_t &hash){
+    std::ifstream file(path, std::ios::binary);
+    char buffer[64 * 1024];
+    size = 0;
+    hash = 14695981039346656037ull;
+    while (file.read(buffer, sizeof(buffer)) || file.gcount()){
+        for (std::streamsize i = 0; i < file.gcount(); ++i){
+            hash ^= static_cast<unsigned char>(buffer[i]);
+            hash *= 1099511628211ull;
+        }
+        size += file.gcount();
+    }
+}
+
+// the value of a "    name    value" line of the --stats report
+bool statsValue(const std::string &stats, const std::string &name, double &value){
+    std::size_t at = stats.find("    " + name + " ");
+    if (at == std::string::npos)
+        return false;
+    value = std::strtod(stats.c_str() + at + name.length() + 4, nullptr);
+    return true;
+}
+
+// The parse benchmark: lines of code of every length, indented, with
+// comments, string literals and multi-line comments in between. The program
+// halts at its first instruction.
+std::string generateProgram(std::size_t size){
+    std::uint64_t state = 1;
+    auto next = [&state](std::uint64_t n){
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return (state >> 33) % n;
+    };
+
+    const char code[] = "dstackDSTACK0123456789";
+    std::string program = "d1kA\n";
+    program.reserve(size + 256);
+    while (program.size() < size){
+        std::uint64_t kind = next(100);
+        if (kind < 10){
+            program += "/ a comment, up to the end of the line\n";
+        } else if (kind < 12){
+            program += "@" + std::to_string(next(1000)) + "\nA string literal with #, $\nand a second line\n@\n";
+        } else if (kind < 13){
+            program += "@\nA comment\nthat takes\nseveral lines\n@\n";
+        } else{
+            program.append(next(3) * 4, ' ');
+            for (std::uint64_t i = next(120) + 1; i > 0; --i){
+                program += code[next(sizeof(code) - 1)];
+                if (next(8) == 0)
+                    program += ' ';
+            }
+            program += '\n';
+        }
+    }
+    return program;
+}
+
+Run run(const std::string &dstack, const std::string &engine, const std::string &program,
+        const std::string &input, const std::string &scratch){
+    Run result = {false, 0, 0, 0, 0, 0, 0, 0};
+    std::string outputPath = scratch + ".out";
+    std::string statsPath = scratch + ".stats";
+
+    auto start = std::chrono::steady_clock::now();
+    pid_t child = fork();
+    if (child < 0)
+        return result;
+
+    if (child == 0){
+        int in = open(input.empty() ? "/dev/null" : input.c_str(), O_RDONLY);
+        int out = open(outputPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        int err = open(statsPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if ((in < 0) || (out < 0) || (err < 0))
+            _exit(127);
+        dup2(in, 0);
+        dup2(out, 1);
+        dup2(err, 2);
+        execl(dstack.c_str(), dstack.c_str(), "-e", engine.c_str(), "--stats", program.c_str(), nullptr);
+        _exit(127);
+    }
+
+    int status;
+    struct rusage usage;
+    if (wait4(child, &status, 0, &usage) != child)
+        return result;
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    result.finished = WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+    result.seconds = elapsed.count();
+    result.peakKilobytes = usage.ru_maxrss;
+
+    std::string stats = readFile(statsPath);
+    double value;
+    if (statsValue(stats, "DStack instructions", value))
+        result.instructions = static_cast<std::uint64_t>(value);
+    if (statsValue(stats, "load time (s)", value))
+        result.loadSeconds = value;
+    if (statsValue(stats, "wall time (s)", value))
+        result.executeSeconds = value;
+
+    hashFile(outputPath, result.outputSize, result.outputHash);
+    std::remove(outputPath.c_str());
+    std::remove(statsPath.c_str());
+    return result;
+}
+
+}
+
+int main(int argc, char *argv[]){
+    if ((argc < 3) || (argc > 5)){
+        std::cerr << "dstack-bench dstack directory [repetitions] [output.csv]\n";
+        return 2;
+    }
+
+    std::string dstack = argv[1];
+    std::filesystem::path directory = argv[2];
+    int repetitions = (argc > 3) ? std::atoi(argv[3]) : 3;
+    if (repetitions < 1)
+        repetitions = 1;
+
+    struct Benchmark{
+        std::string name;
+        std::string program;
+        std::string input;
+        bool checked;
+        std::uint64_t expectedSize;
+        std::uint64_t expectedHash;
+        std::vector<const char*> engines;
+    };
+
+    std::vector<std::filesystem::path> programs;
+    for (const auto &entry : std::filesystem::directory_iterator(directory))
+        if (entry.path().extension() == ".dstck")
+            programs.push_back(entry.path());
+    std::sort(programs.begin(), programs.end());
+
+    std::string scratch = (std::filesystem::temp_directory_path() / ("dstack-bench-" + std::to_string(getpid()))).string();
+
+    std::vector<Benchmark> benchmarks;
+    for (const auto &program : programs){
+        std::filesystem::path input = program;
+        input.replace_extension(".in");
+        std::filesystem::path expectedPath = program;
+        expectedPath.replace_extension(".expected");
+
+        Benchmark benchmark = {program.stem().string(), program.string(),
+                               std::filesystem::exists(input) ? input.string() : std::string(),
+                               std::filesystem::exists(expectedPath), 0, 0, {"switch", "threaded", "blocks", "jit"}};
+        if (benchmark.checked){
+            std::string expected = readFile(expectedPath.string());
+            benchmark.checked = std::sscanf(expected.c_str(), "%" SCNu64 " %" SCNx64,
+                                            &benchmark.expectedSize, &benchmark.expectedHash) == 2;
+        }
+        benchmarks.push_back(benchmark);
+    }
+
+    // parsing doesn't depend on the engine; no output at all
+    std::string parseProgram = scratch + ".dstck";
+    std::string generated = generateProgram(8 * 1024 * 1024);
+    std::ofstream(parseProgram, std::ios::binary) << generated;
+    benchmarks.push_back({"parse", parseProgram, std::string(), true, 0, 14695981039346656037ull, {"switch"}});
+
+    std::ostringstream csv;
+    csv << "benchmark,engine,instructions,wall_seconds,load_seconds,instructions_per_second,peak_rss_kb,output\n";
+    bool allCorrect = true;
+
+    for (const Benchmark &benchmark : benchmarks){
+        for (const char *engine : benchmark.engines){
+            Run best = {false, 0, 0, 0, 0, 0, 0, 0};
+            for (int i = 0; i < repetitions; ++i){
+                Run current = run(dstack, engine, benchmark.program, benchmark.input, scratch);
+                if ((i == 0) || (current.seconds < best.seconds))
+                    best = current;
+            }
+
+            const char *output = "unchecked";
+            if (!best.finished)
+                output = "failed";
+            else if (benchmark.checked)
+                output = ((best.outputSize == benchmark.expectedSize) &&
+                          (best.outputHash == benchmark.expectedHash)) ? "ok" : "wrong";
+            if ((std::strcmp(output, "failed") == 0) || (std::strcmp(output, "wrong") == 0))
+                allCorrect = false;
+
+            double perSecond = (best.executeSeconds > 0) ? best.instructions / best.executeSeconds : 0;
+            csv << benchmark.name << "," << engine << "," << best.instructions << ",";
+            csv << best.seconds << "," << best.loadSeconds << "," << static_cast<std::uint64_t>(perSecond) << ",";
+            csv << best.peakKilobytes << "," << output << "\n";
+
+            if (std::strcmp(output, "wrong") == 0){
+                std::cerr << benchmark.name << " (" << engine << "): got " << best.outputSize;
+                std::cerr << " " << std::hex << best.outputHash << std::dec << "\n";
+            }
+            if ((benchmark.name == "parse") && (best.loadSeconds > 0))
+                std::cerr << "parse: " << generated.size() / best.loadSeconds / (1024 * 1024) << " MiB/s\n";
+        }
+    }
+    std::remove(parseProgram.c_str());
+
+    std::cout << csv.str();
+    if (argc > 4){
+        std::ofstream file(argv[4]);
+        file << csv.str();
+    }
+
+    return allCorrect ? 0 : 1;
+}
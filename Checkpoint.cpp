@@ -0,0 +1,235 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Checkpoint.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char magic[8] = {'D', 'S', 'T', 'K', 'C', 'K', 'P', '\0'};
+const std::uint32_t version = 1;
+
+struct Header{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t layout;
+    std::uint64_t program;
+    std::uint64_t reg;
+    std::uint64_t pos;
+    std::uint64_t steps;
+    std::uint64_t output;
+    std::uint64_t input;
+    std::uint64_t randomSize;
+    std::uint64_t sizes[2];     // values in each stack, the top one included
+};
+
+// size of Number and the byte order of this build
+std::uint32_t layout(){
+    const std::uint16_t probe = 1;
+    unsigned char little;
+    std::memcpy(&little, &probe, 1);
+    return std::uint32_t(sizeof(Number)) | (std::uint32_t(little) << 16);
+}
+
+std::size_t padded(std::size_t size){
+    return (size + 7) & ~std::size_t(7);
+}
+
+bool writeAll(int fd, const void *data, std::size_t size){
+    const char *bytes = static_cast<const char*>(data);
+    while (size > 0){
+#ifdef _WIN32
+        auto written = _write(fd, bytes, static_cast<unsigned int>(std::min<std::size_t>(size, 1 << 30)));
+#else
+        auto written = ::write(fd, bytes, size);
+#endif
+        if (written < 0){
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+bool readAll(int fd, void *data, std::size_t size){
+    char *bytes = static_cast<char*>(data);
+    while (size > 0){
+#ifdef _WIN32
+        auto got = _read(fd, bytes, static_cast<unsigned int>(std::min<std::size_t>(size, 1 << 30)));
+#else
+        auto got = ::read(fd, bytes, size);
+#endif
+        if ((got < 0) && (errno == EINTR))
+            continue;
+        if (got <= 0)
+            return false;
+        bytes += got;
+        size -= got;
+    }
+    return true;
+}
+
+void closeFile(int fd){
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+bool writeStack(int fd, const Stack &stack){
+    Number top = stack.top();
+    return writeAll(fd, stack.lower(), (stack.size() - 1) * sizeof(Number)) &&
+           writeAll(fd, &top, sizeof(top));
+}
+
+// in blocks of a few MB, through a single buffer
+bool readStack(int fd, std::uint64_t size, Stack &stack){
+    const std::size_t block = 512 * 1024;
+    std::vector<Number> values(std::min<std::uint64_t>(size, block));
+
+    stack.clear();
+    if (!readAll(fd, &stack.top(), sizeof(Number)))
+        return false;
+    for (std::uint64_t left = size - 1; left > 0;){
+        std::size_t count = std::min<std::uint64_t>(left, block);
+        if (!readAll(fd, values.data(), count * sizeof(Number)))
+            return false;
+        stack.append(values.data(), count);
+        left -= count;
+    }
+    return true;
+}
+
+}
+
+// a hash of the parsed source (the code characters) and the strings
+std::uint64_t Checkpoint::fingerprint(const Program &program){
+    return hash64(program.strings.serialize(), hash64(program.sourceParsed));
+}
+
+bool Checkpoint::write(const char *path, const char *temporary, const State &state,
+                       std::string_view random, const Stack &first, const Stack &second){
+#ifdef _WIN32
+    int fd = _open(temporary, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, 0644);
+#else
+    int fd = ::open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+    if (fd < 0)
+        return false;
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.layout = layout();
+    header.program = state.program;
+    header.reg = state.reg;
+    header.pos = state.pos;
+    header.steps = state.steps;
+    header.output = state.output;
+    header.input = state.input;
+    header.randomSize = random.size();
+    header.sizes[0] = first.size();
+    header.sizes[1] = second.size();
+
+    const char zeros[8] = {};
+    bool written = writeAll(fd, &header, sizeof(header)) &&
+                   writeAll(fd, random.data(), random.size()) &&
+                   writeAll(fd, zeros, padded(random.size()) - random.size()) &&
+                   writeStack(fd, first) && writeStack(fd, second);
+#ifndef _WIN32
+    written = written && (fsync(fd) == 0);
+#endif
+    closeFile(fd);
+
+    // rename() doesn't replace an existing file on Windows
+#ifdef _WIN32
+    if (written)
+        std::remove(path);
+#endif
+    return written && (std::rename(temporary, path) == 0);
+}
+
+bool Checkpoint::read(const std::string &path, State &state, std::string &random, Stack &first, Stack &second){
+#ifdef _WIN32
+    int fd = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+#endif
+    if (fd < 0){
+        message = "it can't be opened";
+        return false;
+    }
+
+    auto fail = [&](const char *reason){
+        closeFile(fd);
+        message = reason;
+        return false;
+    };
+
+    Header header;
+    if (!readAll(fd, &header, sizeof(header)) || (std::memcmp(header.magic, magic, sizeof(magic)) != 0))
+        return fail("it isn't a checkpoint");
+    if (header.version != version)
+        return fail("it was written by another version of dstack");
+    if (header.layout != layout())
+        return fail("it was written on another platform");
+    if (header.program != state.program)
+        return fail("it was taken from another program");
+    if ((header.randomSize > 4096 * 8) || (header.sizes[0] == 0) || (header.sizes[1] == 0))
+        return fail("the header is damaged");
+
+    random.resize(padded(header.randomSize));
+    if (!readAll(fd, &random[0], random.size()))
+        return fail("the file is truncated");
+    random.resize(header.randomSize);
+
+    if (!readStack(fd, header.sizes[0], first) || !readStack(fd, header.sizes[1], second))
+        return fail("the file is truncated");
+    closeFile(fd);
+
+    state.reg = header.reg;
+    state.pos = header.pos;
+    state.steps = header.steps;
+    state.output = header.output;
+    state.input = header.input;
+    return true;
+}
+
+const std::string &Checkpoint::error() const{
+    return message;
+}
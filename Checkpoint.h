@@ -0,0 +1,63 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "Number.h"
+#include "Program.h"
+#include "Stack.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// --checkpoint and --resume: everything a run needs to go on later from
+// where it was. The file holds a header, the state of the generator
+// (Random::serialize()) and then the values of both stacks, from the
+// bottom, as they are in memory. They are written straight from the
+// stacks and read back in blocks, so a stack of several GB is never copied
+// whole; a checkpoint only loads in a build with the same byte order.
+class Checkpoint{
+public:
+    struct State{
+        std::uint64_t program = 0;  // fingerprint() of the program it comes from
+        Number reg = 0;
+        Number pos = 0;
+        Number steps = 0;
+        std::uint64_t output = 0;   // bytes written so far
+        std::uint64_t input = 0;    // bytes read so far
+    };
+
+    static std::uint64_t fingerprint(const Program &program);
+
+    // Writes temporary and only renames it to path once it is complete, so a
+    // crash never leaves half a checkpoint. It makes no allocations, only
+    // system calls: it can run in the child of fork() while the parent goes
+    // on with the program.
+    static bool write(const char *path, const char *temporary, const State &state,
+                      std::string_view random, const Stack &first, const Stack &second);
+
+    // fills the stacks as it reads them; false (see error()) if the file is
+    // damaged or comes from another program than the one in state.program
+    bool read(const std::string &path, State &state, std::string &random, Stack &first, Stack &second);
+    const std::string &error() const;
+
+private:
+    std::string message;
+};
@@ -0,0 +1,116 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Client.h"
+#include "Files.h"
+#include "Image.h"
+#include "OutputSink.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifndef _WIN32
+// Runs on a thread of its own with its own descriptor, so it can be left
+// blocked on the standard input when the run ends first.
+void sendInput(int fd){
+    Connection server(fd);
+    std::vector<char> buffer(64 * 1024);
+    for (;;){
+        ssize_t count = ::read(0, buffer.data(), buffer.size());
+        if ((count < 0) && (errno == EINTR))
+            continue;
+        if (count <= 0)
+            break;
+        if (!server.send(Connection::Kind::Input, std::string_view(buffer.data(), count)))
+            return;
+    }
+    server.send(Connection::Kind::EndOfInput, std::string_view());
+}
+#endif
+
+}
+
+Client::Client(const Connection::Settings &settings):
+settings(settings){
+    this->settings.version = Connection::version;
+}
+
+bool Client::connect(const std::string &socket){
+    if (server.connect(socket))
+        return true;
+    message = server.error();
+    return false;
+}
+
+const std::string &Client::error() const{
+    return message;
+}
+
+int Client::run(const std::string &file){
+#ifndef _WIN32
+    OutputSink out(1);
+    Image image;
+    std::string program;
+    Connection::Kind kind = Connection::Kind::Source;
+    if (image.open(file) != Image::Result::NotImage){
+        char full[PATH_MAX];
+        program = realpath(file.c_str(), full) ? full : file;
+        kind = Connection::Kind::Path;
+    } else if (!readFile(file, program)){
+        out.write("The file could not be opened (" + file + ")");
+        return 2;
+    }
+
+    int input = ::dup(server.descriptor());
+    if ((input < 0) ||
+        !server.send(Connection::Kind::Settings, std::string_view(reinterpret_cast<const char*>(&settings), sizeof(settings))) ||
+        !server.send(kind, program)){
+        if (input >= 0)
+            ::close(input);
+        out.write("The server could not be reached\n");
+        return 2;
+    }
+    std::thread(sendInput, input).detach();
+
+    std::string data;
+    while (server.receive(kind, data)){
+        if ((kind == Connection::Kind::Output) || (kind == Connection::Kind::Message)){
+            out.write(data);
+            out.flush();
+        } else if (kind == Connection::Kind::Exit){
+            return std::atoi(data.c_str());
+        }
+    }
+
+    out.write("The connection to the server was lost\n");
+    return 3;
+#else
+    (void)file;
+    return 2;
+#endif
+}
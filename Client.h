@@ -0,0 +1,45 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "Connection.h"
+
+#include <string>
+
+// The other end of dstack --serve (Server.h): it sends a program to the
+// server and stands in for the run in a pipeline. The standard input goes
+// to the server as it comes, and what the program writes, and any error,
+// comes out of the standard output just as dstack would write it.
+class Client{
+public:
+    explicit Client(const Connection::Settings &settings);
+
+    bool connect(const std::string &socket);
+    const std::string &error() const;
+
+    // The exit status of the run. A source file is sent as it is, so the
+    // server can find it in its cache; an image only by its full path.
+    int run(const std::string &file);
+
+private:
+    Connection::Settings settings;
+    Connection server;
+    std::string message;
+};
@@ -0,0 +1,296 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Connection.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifndef _WIN32
+// writing to a closed connection fails instead of raising SIGPIPE
+void noSignals(int fd){
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+    (void)fd;
+#endif
+}
+
+// the same, on systems without SO_NOSIGPIPE
+#ifdef MSG_NOSIGNAL
+const int sendFlags = MSG_NOSIGNAL;
+#else
+const int sendFlags = 0;
+#endif
+
+bool sendAll(int fd, const char *data, std::size_t size){
+    while (size > 0){
+        ssize_t count = ::send(fd, data, size, sendFlags);
+        if (count < 0){
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += count;
+        size -= static_cast<std::size_t>(count);
+    }
+    return true;
+}
+
+// as much as the socket takes right now
+bool sendSome(int fd, const char *data, std::size_t size, std::size_t &sent){
+    sent = 0;
+    while (sent < size){
+        ssize_t count = ::send(fd, data + sent, size - sent, sendFlags | MSG_DONTWAIT);
+        if (count < 0){
+            if (errno == EINTR)
+                continue;
+            return (errno == EAGAIN) || (errno == EWOULDBLOCK);
+        }
+        sent += static_cast<std::size_t>(count);
+    }
+    return true;
+}
+
+bool receiveAll(int fd, char *data, std::size_t size){
+    while (size > 0){
+        ssize_t count = ::recv(fd, data, size, 0);
+        if (count < 0){
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        if (count == 0)
+            return false;
+        data += count;
+        size -= static_cast<std::size_t>(count);
+    }
+    return true;
+}
+#endif
+
+}
+
+Connection::Connection(int fd):
+fd(fd){
+#ifndef _WIN32
+    if (fd >= 0)
+        noSignals(fd);
+#endif
+}
+
+Connection::~Connection(){
+    close();
+}
+
+Connection::Connection(Connection &&other):
+fd      (other.fd),
+message (std::move(other.message)),
+outgoing(std::move(other.outgoing)),
+incoming(std::move(other.incoming)){
+    other.fd = -1;
+}
+
+Connection &Connection::operator=(Connection &&other){
+    if (this != &other){
+        close();
+        fd = other.fd;
+        message = std::move(other.message);
+        outgoing = std::move(other.outgoing);
+        incoming = std::move(other.incoming);
+        other.fd = -1;
+    }
+    return *this;
+}
+
+bool Connection::connect(const std::string &path){
+    close();
+#ifndef _WIN32
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)){
+        message = "The socket path is too long (" + path + ")";
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if ((fd >= 0) && (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0)){
+        noSignals(fd);
+        return true;
+    }
+
+    message = "Could not connect to " + path + ": " + std::strerror(errno);
+    close();
+    return false;
+#else
+    message = "UNIX domain sockets are not supported on this system";
+    return false;
+#endif
+}
+
+bool Connection::send(Kind kind, std::string_view data){
+#ifndef _WIN32
+    if ((fd < 0) || (data.size() > maxSize))
+        return false;
+
+    char header[5];
+    std::uint32_t size = static_cast<std::uint32_t>(data.size());
+    header[0] = static_cast<char>(kind);
+    std::memcpy(header + 1, &size, sizeof(size));
+    return sendAll(fd, header, sizeof(header)) && sendAll(fd, data.data(), data.size());
+#else
+    return false;
+#endif
+}
+
+bool Connection::post(Kind kind, std::string_view data){
+#ifndef _WIN32
+    if ((fd < 0) || (data.size() > maxSize))
+        return false;
+
+    char header[5];
+    std::uint32_t size = static_cast<std::uint32_t>(data.size());
+    header[0] = static_cast<char>(kind);
+    std::memcpy(header + 1, &size, sizeof(size));
+    outgoing.append(header, sizeof(header));
+    outgoing.append(data.data(), data.size());
+    return flush();
+#else
+    (void)kind;
+    (void)data;
+    return false;
+#endif
+}
+
+bool Connection::flush(){
+#ifndef _WIN32
+    std::size_t sent;
+    if ((fd < 0) || !sendSome(fd, outgoing.data(), outgoing.size(), sent))
+        return false;
+    outgoing.erase(0, sent);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool Connection::receive(Kind &kind, std::string &data){
+#ifndef _WIN32
+    char header[5];
+    std::uint32_t size;
+    if ((fd < 0) || !receiveAll(fd, header, sizeof(header)))
+        return false;
+
+    std::memcpy(&size, header + 1, sizeof(size));
+    if (size > maxSize)
+        return false;
+
+    kind = static_cast<Kind>(header[0]);
+    data.resize(size);
+    return receiveAll(fd, &data[0], size);
+#else
+    return false;
+#endif
+}
+
+bool Connection::collect(){
+#ifndef _WIN32
+    if (fd < 0)
+        return false;
+
+    // a bounded amount, so that one client can't keep the caller reading
+    const std::size_t chunk = 64 * 1024;
+    for (std::size_t total = 0; total < 16 * chunk; ){
+        std::size_t size = incoming.size();
+        incoming.resize(size + chunk);
+        ssize_t count = ::recv(fd, &incoming[size], chunk, MSG_DONTWAIT);
+        incoming.resize(size + std::max<ssize_t>(count, 0));
+        if (count < 0){
+            if (errno == EINTR)
+                continue;
+            return (errno == EAGAIN) || (errno == EWOULDBLOCK);
+        }
+        if (count == 0)
+            return false;
+        total += static_cast<std::size_t>(count);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool Connection::take(Kind &kind, std::string &data){
+    const std::size_t headerSize = 5;
+    if (incoming.size() < headerSize)
+        return false;
+
+    std::uint32_t size;
+    std::memcpy(&size, incoming.data() + 1, sizeof(size));
+    if (size > maxSize){
+        close();
+        return false;
+    }
+    if (incoming.size() < headerSize + size)
+        return false;
+
+    kind = static_cast<Kind>(incoming[0]);
+    data.assign(incoming, headerSize, size);
+    incoming.erase(0, headerSize + size);
+    return true;
+}
+
+bool Connection::closed() const{
+#ifndef _WIN32
+    // hung up, even with bytes still to be received
+    pollfd state = {fd, 0, 0};
+    if ((::poll(&state, 1, 0) > 0) && (state.revents & (POLLHUP | POLLERR)))
+        return true;
+
+    char byte;
+    ssize_t count = ::recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (count < 0)
+        return (errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR);
+    return count == 0;
+#else
+    return true;
+#endif
+}
+
+void Connection::close(){
+#ifndef _WIN32
+    if (fd >= 0)
+        ::close(fd);
+#endif
+    fd = -1;
+}
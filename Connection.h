@@ -0,0 +1,118 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "Number.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// One end of a UNIX domain socket between dstack --serve (Server.h) and a
+// client (Client.h). Everything goes in messages of a kind byte, a 32-bit
+// length and that many bytes. Both ends are on the same machine, so
+// numbers are sent in its own byte order.
+//
+// A run goes like this: the client sends Settings, then Source or Path,
+// then any number of Input messages and EndOfInput, whenever it has them.
+// The server starts as soon as it has the program and sends Output as the
+// program writes it, Message if it fails, and Exit with the exit status
+// dstack would have given, which ends the run and the connection.
+class Connection{
+public:
+    enum class Kind : char {
+        Settings    = 'L',
+        Source      = 'S',      // the text of the program
+        Path        = 'P',      // or the file the server reads it from
+        Input       = 'I',
+        EndOfInput  = 'E',
+        Output      = 'O',
+        Message     = 'M',
+        Exit        = 'X'
+    };
+
+    static const std::uint32_t version = 1;
+    static const std::uint32_t maxSize = 256 * 1024 * 1024;
+
+    struct Settings{
+        std::uint32_t version;
+        std::uint8_t engine;        // Engine
+        std::uint8_t flush;         // OutputSink::Flush
+        std::uint8_t generator;     // Random::Generator
+        std::uint8_t padding;
+        Number seed;
+        Number steps;               // Limits
+        std::uint64_t depth;
+        std::uint64_t memory;
+        double seconds;
+    };
+
+    explicit Connection(int fd = -1);
+    ~Connection();
+
+    Connection(Connection &&other);
+    Connection &operator=(Connection &&other);
+
+    // false, with error() set, if there is no server there
+    bool connect(const std::string &path);
+
+    bool valid() const{
+        return fd >= 0;
+    }
+    int descriptor() const{
+        return fd;
+    }
+    const std::string &error() const{
+        return message;
+    }
+
+    bool send(Kind kind, std::string_view data);
+
+    // send() without waiting: the socket takes what it can now and the rest
+    // is queued (after anything queued before) for flush(), which doesn't
+    // wait either. Both are false if the connection failed.
+    bool post(Kind kind, std::string_view data);
+    bool flush();
+    std::size_t queued() const{
+        return outgoing.size();
+    }
+
+    // false when the other end closed the connection (or broke the format)
+    bool receive(Kind &kind, std::string &data);
+
+    // receive() without waiting: collect() reads what the socket has now,
+    // false if the other end closed the connection, and take() gives the
+    // next message once all of it is there. A message that breaks the format
+    // closes the connection (valid() is false then).
+    bool collect();
+    bool take(Kind &kind, std::string &data);
+
+    // whether the other end closed it, without waiting nor taking anything
+    bool closed() const;
+
+    void close();
+
+private:
+    int fd;
+    std::string message;
+    std::string outgoing;       // what post() couldn't send yet
+    std::string incoming;       // what collect() read and take() didn't give yet
+};
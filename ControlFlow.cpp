@@ -0,0 +1,69 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "ControlFlow.h"
+
+namespace {
+
+bool endsBlock(Opcodes code){
+    return (code == Opcodes::Jump) || (code == Opcodes::Reset) || (code == Opcodes::Halt);
+}
+
+}
+
+ControlFlow findBlocks(InstructionView fused, const std::vector<Number> &constants){
+    const Number size = fused.size();
+    std::vector<bool> leader(size, false);
+    if (size > 0)
+        leader[0] = true;
+
+    for (Number i = 0; i < size; ++i){
+        const Instruction &instruction = fused[i];
+        switch (instruction.code){
+            case Opcodes::Save:
+            case Opcodes::Jump:
+            case Opcodes::Reset:    if (i + 1 < size)
+                                        leader[i + 1] = true;
+                                    break;
+            case Opcodes::Constant:
+            case Opcodes::PushConst:if (constants[instruction.constant] < size)
+                                        leader[constants[instruction.constant]] = true;
+                                    break;
+            default:                break;
+        }
+    }
+
+    ControlFlow flow;
+    flow.blockAt.assign(size, ControlFlow::noBlock);
+    for (Number start = 0; start < size; ++start){
+        if (!leader[start])
+            continue;
+
+        Number end = start;
+        Opcodes last;
+        do{
+            last = fused[end].code;
+            end += fused[end].length;
+        } while ((end < size) && !leader[end] && !endsBlock(last));
+
+        flow.blockAt[start] = static_cast<std::uint32_t>(flow.blocks.size());
+        flow.blocks.push_back(BasicBlock{start, end});
+    }
+    return flow;
+}
@@ -0,0 +1,48 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "Number.h"
+#include "Opcodes.h"
+
+#include <cstdint>
+#include <vector>
+
+// Splits a fused program (Fusion.h) into basic blocks for the blocks engine.
+// Jump goes wherever the top of a stack says, so the targets can't be known
+// for sure, but programs almost always jump back to a position pushed by
+// Save or to a constant they pushed themselves. Those positions, the start
+// and the ones after a Jump or a Reset (which go on when reg is 0) begin a
+// block. A block ends where another one begins, or after a Jump, Reset or
+// Halt. A superinstruction that covers the start of another block just
+// goes on; blocks only have to begin at their start.
+struct BasicBlock{
+    Number start;
+    Number end;         // where it falls through to
+};
+
+struct ControlFlow{
+    static constexpr std::uint32_t noBlock = UINT32_MAX;
+
+    std::vector<BasicBlock> blocks;         // by start
+    std::vector<std::uint32_t> blockAt;     // by position: the block that starts there, or noBlock
+};
+
+ControlFlow findBlocks(InstructionView fused, const std::vector<Number> &constants);
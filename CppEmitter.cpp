@@ -0,0 +1,345 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Interpreter.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string_view>
+
+// Translates the loaded program to a standalone C++ source file. Every
+// position becomes a case of one big switch and falls through to the next
+// one; jumps (and Reset) go back to the switch with the new position. The
+// runtime below reproduces what Interpreter does for the instructions that
+// are not written inline.
+
+namespace {
+
+const char *runtime = R"(#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#else
+#include <unistd.h>
+#endif
+
+typedef std::uint64_t Number;
+typedef std::vector<Number> Stack;
+
+struct StringEntry{
+    Number id;
+    const char *text;
+    std::size_t length;
+};
+
+Stack stackA{0};
+Stack stackB{0};
+Number reg = 0;
+const bool terminal = isatty(0) != 0;
+std::mt19937 randomEngine(std::chrono::high_resolution_clock::now().time_since_epoch().count());
+
+const StringEntry *findString(Number id);
+
+char toChar(Number number){
+    return static_cast<char>(number % 256);
+}
+
+std::string toString(Number number){
+    std::ostringstream os;
+    os << number;
+    return os.str();
+}
+
+void pushString(Number id, Stack &stack, bool reversed){
+    const StringEntry *entry = findString(id);
+    if (!entry)
+        return;
+    std::string s(entry->text, entry->length);
+    if (reversed)
+        std::reverse(s.begin(), s.end());
+    for (char ch : s)
+        stack.push_back(Number(ch));
+}
+
+void send(Stack &first, Stack &second){
+    second.push_back(first.back());
+    first.pop_back();
+    if (first.empty())
+        first.push_back(0);
+}
+
+void pop(Stack &first){
+    first.pop_back();
+    if (first.empty())
+        first.push_back(0);
+}
+
+Number getRandom(Number min, Number max){
+    return std::uniform_int_distribution<Number>{min, max}(randomEngine);
+}
+
+template<class T>
+std::string interpolate(std::string s, const T &n1, const T &n2){
+    std::string::size_type pos;
+
+    while ((pos = s.find("#")) != std::string::npos)
+        s.replace(pos, 1, std::string() + n1);
+
+    while ((pos = s.find("$")) != std::string::npos)
+        s.replace(pos, 1, std::string() + n2);
+
+    return s;
+}
+
+void printString(Number id){
+    if (const StringEntry *entry = findString(id))
+        std::cout << std::string(entry->text, entry->length);
+}
+
+void printInterpolatedNumbers(Number id, const Stack &first, const Stack &second){
+    if (const StringEntry *entry = findString(id))
+        std::cout << interpolate(std::string(entry->text, entry->length),
+                                 toString(first.back()), toString(second.back()));
+}
+
+void printInterpolatedCharacters(Number id, const Stack &first, const Stack &second){
+    if (const StringEntry *entry = findString(id))
+        std::cout << interpolate(std::string(entry->text, entry->length),
+                                 toChar(first.back()), toChar(second.back()));
+}
+
+// Lines without a number are skipped, 0 at the end of the input
+Number readNumber(){
+    std::string tmp;
+    while (std::getline(std::cin, tmp)){
+        Number number;
+        std::stringstream ss(tmp);
+        if (ss >> number)
+            return number;
+    }
+
+    std::cin.clear();
+    return Number(0);
+}
+
+Number readChar(){
+    char ch;
+    if (std::cin.get(ch)){
+        return static_cast<Number>(ch);
+    } else{
+        std::cin.clear();
+        return Number(0);
+    }
+}
+
+void reset(){
+    reg = 0;
+    stackA.clear(); stackA.push_back(0);
+    stackB.clear(); stackB.push_back(0);
+    std::cin.clear();
+    // only what was typed ahead on a terminal is dropped
+    if (terminal)
+        std::cin.ignore(std::cin.rdbuf()->in_avail());
+}
+
+void error(const char *message, unsigned long line, unsigned long col){
+    std::cout << std::string(79, '*') << "\n";
+    std::cout << message << " in " << line << ":" << col << "\n";
+    std::cout << std::string(79, '*') << "\n";
+    std::exit(3);
+}
+
+// an instruction the interpreter would stop at too, reported on stderr
+// after what was printed so far
+void invalid(unsigned long line, unsigned long col){
+    std::cout.flush();
+    std::cerr << std::string(79, '*') << "\n";
+    std::cerr << "Invalid instruction in " << line << ":" << col << "\n";
+    std::cerr << std::string(79, '*') << "\n";
+    std::exit(3);
+}
+
+// Halt with a zero register never moves on
+void hang(){
+    for (;;)
+        std::this_thread::sleep_for(std::chrono::hours(1));
+}
+
+)";
+
+// octal escapes keep every byte intact, whatever follows it
+std::string quote(std::string_view s){
+    std::string quoted = "\"";
+    for (char ch : s){
+        unsigned char byte = static_cast<unsigned char>(ch);
+        if ((byte >= 32) && (byte <= 126) && (ch != '"') && (ch != '\\') && (ch != '?')){
+            quoted += ch;
+        } else{
+            quoted += '\\';
+            quoted += static_cast<char>('0' + ((byte >> 6) & 7));
+            quoted += static_cast<char>('0' + ((byte >> 3) & 7));
+            quoted += static_cast<char>('0' + (byte & 7));
+        }
+    }
+    quoted += '"';
+    return quoted;
+}
+
+}
+
+void Interpreter::emitCpp(std::ostream &out) const{
+    const StringTable &strings = loaded->strings;
+    const InstructionView instructions = loaded->instructions;
+
+    out << "// Generated by dstack --emit-cpp\n\n";
+    out << runtime;
+
+    Number index = 0;
+    for (const auto &entry : strings.entries())
+        out << "constexpr char string" << index++ << "[] = " << quote(strings.text(entry)) << ";\n";
+
+    out << "\n// sorted by id\n";
+    out << "constexpr StringEntry strings[] = {\n";
+    index = 0;
+    for (const auto &entry : strings.entries()){
+        out << "    {" << entry.id << "u, string" << index << ", ";
+        out << entry.length << "},\n";
+        ++index;
+    }
+    if (strings.empty())
+        out << "    {0, nullptr, 0},\n";
+    out << "};\n\n";
+
+    out << "const StringEntry *findString(Number id){\n";
+    out << "    const std::size_t count = " << strings.entries().size() << ";\n";
+    out << "    const StringEntry *end = strings + count;\n";
+    out << "    const StringEntry *entry = std::lower_bound(strings, end, id,\n";
+    out << "        [](const StringEntry &e, Number n){ return e.id < n; });\n";
+    out << "    return ((entry != end) && (entry->id == id)) ? entry : nullptr;\n";
+    out << "}\n\n";
+
+    bool jumps = std::any_of(instructions.begin(), instructions.end(), [](const Instruction &instruction){
+        return (instruction.code == Opcodes::Jump) || (instruction.code == Opcodes::Reset);
+    });
+
+    out << "int main(){\n";
+    out << "    Number pos = 0;\n\n";
+    if (jumps)
+        out << "dispatch:\n";
+    out << "    switch (pos){\n";
+
+    for (Number i = 0; i < instructions.size(); ++i){
+        const Instruction &instruction = instructions[i];
+        const char *first = instruction.alt ? "stackB" : "stackA";
+        const char *second = instruction.alt ? "stackA" : "stackB";
+        std::string f = std::string(first) + ".back()";
+        std::string s = std::string(second) + ".back()";
+
+        PositionInfo position = positionOf(i);
+
+        out << "    case " << i << ": // " << toString(instruction.code) << "\n";
+        out << "        ";
+
+        switch (instruction.code){
+            case Opcodes::Digit:    out << "reg = reg * 10 + " << int(instruction.digit) << ";"; break;
+            case Opcodes::Error:    out << "invalid(" << position.line << ", " << position.col << ");"; break;
+
+            case Opcodes::None:     break;
+
+            case Opcodes::Add:      out << "reg = " << f << " + " << s << ";"; break;
+            case Opcodes::Mul:      out << "reg = " << f << " * " << s << ";"; break;
+            case Opcodes::Sub:      out << "reg = " << f << " - " << s << ";"; break;
+            case Opcodes::Pow:      out << "reg = std::pow(" << f << ", " << s << ");"; break;
+            case Opcodes::Div:      out << "if (" << s << " == 0) error(\"Division by zero\", ";
+                                    out << position.line << ", " << position.col << ");\n";
+                                    out << "        reg = " << f << " / " << s << ";";
+                                    break;
+            case Opcodes::Rem:      out << "if (" << s << " == 0) error(\"Division by zero (remainder operation)\", ";
+                                    out << position.line << ", " << position.col << ");\n";
+                                    out << "        reg = " << f << " % " << s << ";";
+                                    break;
+
+            case Opcodes::Zero:     out << "reg = 0;"; break;
+
+            case Opcodes::Equal:    out << "reg = " << f << " == " << s << ";"; break;
+            case Opcodes::Unequal:  out << "reg = " << f << " != " << s << ";"; break;
+            case Opcodes::BetweenI: out << "reg = (std::min(" << f << ", " << s << ") <= reg) && ";
+                                    out << "(reg <= std::max(" << f << ", " << s << "));";
+                                    break;
+            case Opcodes::BetweenE: out << "reg = (std::min(" << f << ", " << s << ") < reg) && ";
+                                    out << "(reg < std::max(" << f << ", " << s << "));";
+                                    break;
+            case Opcodes::Greater:  out << "reg = " << f << " > " << s << ";"; break;
+            case Opcodes::GreOrEq:  out << "reg = " << f << " >= " << s << ";"; break;
+            case Opcodes::Not:      out << "reg = !" << f << ";"; break;
+            case Opcodes::And:      out << "reg = Number(" << f << " && " << s << ");"; break;
+            case Opcodes::Or:       out << "reg = Number(" << f << " || " << s << ");"; break;
+            case Opcodes::Xor:      out << "reg = Number(!" << f << " != !" << s << ");"; break;
+
+            case Opcodes::Rand:     out << "if (" << f << " <= " << s << ") reg = getRandom(" << f << ", " << s << ");"; break;
+            case Opcodes::Min:      out << "reg = std::min(" << f << ", " << s << ");"; break;
+            case Opcodes::Max:      out << "reg = std::max(" << f << ", " << s << ");"; break;
+
+            case Opcodes::Push:     out << first << ".push_back(reg);"; break;
+            case Opcodes::PushS:    out << "pushString(reg, " << first << ", false);"; break;
+            case Opcodes::PushRS:   out << "pushString(reg, " << first << ", true);"; break;
+            case Opcodes::Send:     out << "send(" << first << ", " << second << ");"; break;
+            case Opcodes::Peek:     out << "reg = " << f << ";"; break;
+            case Opcodes::Pop:      out << "pop(" << first << ");"; break;
+            case Opcodes::Swap:     out << "std::swap(" << f << ", " << s << ");"; break;
+
+            case Opcodes::Save:     out << first << ".push_back(" << i + 1 << "u);"; break;
+            case Opcodes::Jump:     out << "if (reg){ pos = " << f << "; goto dispatch; }"; break;
+            case Opcodes::Reset:    out << "if (reg){ reset(); pos = 0; goto dispatch; }"; break;
+            case Opcodes::Halt:     out << "if (reg) return 0;\n";
+                                    out << "        hang();";
+                                    break;
+
+            case Opcodes::PrintN:   out << "std::cout << toString(reg);"; break;
+            case Opcodes::PrintC:   out << "std::cout << toChar(reg);"; break;
+            case Opcodes::PrintS:   out << "printString(reg);"; break;
+            case Opcodes::PrintSiN: out << "printInterpolatedNumbers(reg, " << first << ", " << second << ");"; break;
+            case Opcodes::PrintSiC: out << "printInterpolatedCharacters(reg, " << first << ", " << second << ");"; break;
+            case Opcodes::ReadN:    out << "reg = readNumber();"; break;
+            case Opcodes::ReadC:    out << "reg = readChar();"; break;
+
+            default:                break; // superinstructions are never decoded
+        }
+
+        out << "\n";
+    }
+
+    out << "    default:\n";
+    out << "        break;\n";
+    out << "    }\n\n";
+    out << "    return 0;\n";
+    out << "}\n";
+}
@@ -0,0 +1,44 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Files.h"
+
+#include <fstream>
+#include <sstream>
+
+bool readFile(const std::string &path, std::string &contents, std::ios::openmode mode){
+    std::ifstream file(path.c_str(), mode);
+    if (!file)
+        return false;
+
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    if (size >= 0){
+        contents.resize(static_cast<std::size_t>(size));
+        file.seekg(0);
+        file.read(&contents[0], size);
+        contents.resize(static_cast<std::size_t>(file.gcount()));
+    } else{
+        file.clear();
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        contents = buffer.str();
+    }
+    return true;
+}
@@ -0,0 +1,132 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Fusion.h"
+
+#include <array>
+#include <limits>
+#include <unordered_map>
+
+namespace {
+
+// keeps Instruction::length and the digit count inside a byte
+const std::size_t maxLength = 200;
+
+// Opcodes::None positions starting at i
+std::size_t countNones(InstructionView instructions, std::size_t i, std::size_t limit){
+    std::size_t count = 0;
+    while ((i + count < instructions.size()) && (count < limit) &&
+           (instructions[i + count].code == Opcodes::None))
+        ++count;
+    return count;
+}
+
+}
+
+std::vector<Instruction> fuse(InstructionView instructions, std::vector<Number> &constants){
+    typedef std::size_t size_type;
+
+    std::vector<Instruction> fused(instructions.begin(), instructions.end());
+    std::unordered_map<Number, std::uint32_t> indices;  // in constants
+
+    for (size_type i = 0; i < instructions.size(); ++i){
+        Instruction &instruction = fused[i];
+
+        switch (instructions[i].code){
+            case Opcodes::Digit:
+            case Opcodes::Zero:{
+                // a run of digits (each one appended to reg) and the Nones
+                // that always follow it, optionally preceded by a Zero and
+                // followed by a Push
+                bool zero = instructions[i].code == Opcodes::Zero;
+                size_type j = zero ? i + 1 : i;
+                Number value = 0;
+                unsigned int digits = 0;
+                while ((j < instructions.size()) && (j - i < maxLength) &&
+                       (instructions[j].code == Opcodes::Digit)){
+                    value = value * 10 + instructions[j].digit;
+                    ++digits;
+                    ++j;
+                }
+                j += countNones(instructions, j, maxLength - (j - i));
+
+                bool push = zero && (j < instructions.size()) && (j - i < maxLength) &&
+                            (instructions[j].code == Opcodes::Push);
+                if (push){
+                    instruction.code = Opcodes::PushConst;
+                    instruction.alt = instructions[j].alt;
+                    ++j;
+                } else if (zero){
+                    instruction.code = Opcodes::Constant;
+                } else{
+                    instruction.code = Opcodes::Digits;
+                    instruction.digit = digits;
+                }
+
+                // a value only gets a constant when the superinstruction is kept
+                bool kept = j - i >= 2;
+                auto index = indices.find(value);
+                if (kept && (index == indices.end())){
+                    if (constants.size() < std::numeric_limits<std::uint32_t>::max()){
+                        index = indices.emplace(value, static_cast<std::uint32_t>(constants.size())).first;
+                        constants.push_back(value);
+                    } else{
+                        kept = false;
+                    }
+                }
+
+                if (kept){
+                    instruction.constant = index->second;
+                    instruction.length = j - i;
+                } else{
+                    instruction = instructions[i];
+                }
+            } break;
+            case Opcodes::None:
+                instruction.length = countNones(instructions, i, maxLength);
+                break;
+            case Opcodes::Peek:
+                if ((i + 1 < instructions.size()) &&
+                    (instructions[i + 1].code == Opcodes::Pop) &&
+                    (instructions[i + 1].alt == instructions[i].alt)){
+                    instruction.code = Opcodes::PeekPop;
+                    instruction.length = 2;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return fused;
+}
+
+Number powerOfTen(unsigned int exponent){
+    static const std::array<Number, 256> powers = []{
+        std::array<Number, 256> table;
+        Number power = 1;
+        for (Number &entry : table){
+            entry = power;
+            power *= 10;
+        }
+        return table;
+    }();
+
+    return powers[exponent & 0xFF];
+}
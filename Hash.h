@@ -0,0 +1,35 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// 64-bit FNV-1a, a 64-bit word at a time (and the bytes that don't fill
+// one, one by one). Not meant to stop anybody on purpose, only to tell
+// contents apart. Passing the result as basis goes on hashing after it.
+const std::uint64_t hashBasis = 0xcbf29ce484222325;
+
+std::uint64_t hash64(const char *data, std::size_t size, std::uint64_t basis = hashBasis);
+
+inline std::uint64_t hash64(std::string_view data, std::uint64_t basis = hashBasis){
+    return hash64(data.data(), data.size(), basis);
+}
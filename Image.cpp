@@ -0,0 +1,274 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Image.h"
+#include "Hash.h"
+
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char magic[8] = {'D', 'S', 'T', 'K', 'I', 'M', 'G', '\0'};
+
+// has to change whenever Instruction or the order of the sections do
+const std::uint32_t version = 3;
+
+struct Header{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t layout;
+    std::uint64_t checksum;     // of everything after the header
+    std::uint64_t size;         // bytes after the header
+    std::uint64_t count;        // instructions
+    std::uint64_t constants;
+    std::uint64_t sourceLength;
+    std::uint64_t stringsSize;
+    std::uint64_t linesSize;
+};
+
+// size of Instruction and the byte order of this build (the tables check
+// their own sizes)
+std::uint32_t layout(){
+    const std::uint16_t probe = 1;
+    unsigned char little;
+    std::memcpy(&little, &probe, 1);
+    return std::uint32_t(sizeof(Instruction)) | (std::uint32_t(little) << 16);
+}
+
+std::size_t padded(std::size_t size){
+    return (size + 7) & ~std::size_t(7);
+}
+
+// After the header: the instructions, the fused instructions, the constants,
+// the source, the strings and the lines, each one starting at a multiple of
+// 8 bytes.
+std::size_t payloadSize(const Header &header){
+    return 2 * header.count * sizeof(Instruction) + header.constants * sizeof(Number) +
+           padded(header.sourceLength) + padded(header.stringsSize) + padded(header.linesSize);
+}
+
+void append(std::string &out, const void *data, std::size_t size){
+    out.append(static_cast<const char*>(data), size);
+    out.append(padded(size) - size, '\0');
+}
+
+// stops early only at the end of the file (or on an error)
+std::size_t readUpTo(int fd, char *data, std::size_t size){
+    std::size_t total = 0;
+    while (total < size){
+#ifdef _WIN32
+        auto got = _read(fd, data + total, static_cast<unsigned int>(size - total));
+#else
+        auto got = ::read(fd, data + total, size - total);
+#endif
+        if (got <= 0)
+            break;
+        total += got;
+    }
+    return total;
+}
+
+void closeFile(int fd){
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+}
+
+Image::~Image(){
+    close();
+}
+
+Image::Result Image::open(const std::string &path){
+    close();
+
+#ifdef _WIN32
+    int fd = _open(path.c_str(), _O_RDONLY | _O_BINARY);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+#endif
+    if (fd < 0)
+        return Result::NotImage;
+
+#ifndef _WIN32
+    // peeking at a pipe would eat the beginning of the source
+    struct stat kind;
+    if ((fstat(fd, &kind) != 0) || !S_ISREG(kind.st_mode)){
+        closeFile(fd);
+        return Result::NotImage;
+    }
+#endif
+
+    auto fail = [&](const char *reason){
+        closeFile(fd);
+        close();
+        message = reason;
+        return Result::Invalid;
+    };
+
+    Header header;
+    std::size_t got = readUpTo(fd, reinterpret_cast<char*>(&header), sizeof(header));
+    if ((got < sizeof(magic)) || (std::memcmp(header.magic, magic, sizeof(magic)) != 0)){
+        closeFile(fd);
+        return Result::NotImage;
+    }
+    if (got < sizeof(header))
+        return fail("the file is truncated");
+    if (header.version != version)
+        return fail("it was compiled by another version of dstack");
+    if (header.layout != layout())
+        return fail("it was compiled for another platform");
+    if ((header.count > header.size) || (header.constants > header.size) || (header.sourceLength > header.size) ||
+        (header.stringsSize > header.size) || (header.linesSize > header.size) ||
+        (payloadSize(header) != header.size) ||
+        ((header.count != 0) && (header.sourceLength != header.count + 1)))
+        return fail("the header is damaged");
+
+    std::size_t total = sizeof(header) + header.size;
+#ifdef _WIN32
+    buffer.resize(total / 8 + 1);
+    char *data = reinterpret_cast<char*>(buffer.data());
+    std::memcpy(data, &header, sizeof(header));
+    if (readUpTo(fd, data + sizeof(header), header.size) != header.size)
+        return fail("the file is truncated");
+#else
+    struct stat info;
+    if ((fstat(fd, &info) != 0) || (std::uint64_t(info.st_size) < total))
+        return fail("the file is truncated");
+
+    const char *data;
+    void *memory = mmap(nullptr, total, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (memory != MAP_FAILED){
+        mapping = memory;
+        mappingSize = total;
+        data = static_cast<const char*>(memory);
+    } else{
+        buffer.resize(total / 8 + 1);
+        char *copy = reinterpret_cast<char*>(buffer.data());
+        std::memcpy(copy, &header, sizeof(header));
+        if (readUpTo(fd, copy + sizeof(header), header.size) != header.size)
+            return fail("the file is truncated");
+        data = copy;
+    }
+#endif
+
+    if (hash64(data + sizeof(header), header.size) != header.checksum)
+        return fail("the file is damaged");
+
+    closeFile(fd);
+    payload = data + sizeof(header);
+    count = header.count;
+    constantCount = header.constants;
+    sourceLength = header.sourceLength;
+    stringsSize = header.stringsSize;
+    linesSize = header.linesSize;
+    return Result::Loaded;
+}
+
+const std::string &Image::error() const{
+    return message;
+}
+
+bool Image::write(const std::string &path, InstructionView instructions, InstructionView fused,
+                  const std::vector<Number> &constants, std::string_view source,
+                  const std::string &strings, const std::string &lines){
+    Header header;
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.layout = layout();
+    header.count = instructions.size();
+    header.constants = constants.size();
+    header.sourceLength = source.size();
+    header.stringsSize = strings.size();
+    header.linesSize = lines.size();
+    header.size = payloadSize(header);
+
+    std::string out;
+    out.reserve(sizeof(header) + header.size);
+    out.append(sizeof(header), '\0');
+    append(out, instructions.data(), instructions.size() * sizeof(Instruction));
+    append(out, fused.data(), fused.size() * sizeof(Instruction));
+    append(out, constants.data(), constants.size() * sizeof(Number));
+    append(out, source.data(), source.size());
+    append(out, strings.data(), strings.size());
+    append(out, lines.data(), lines.size());
+
+    header.checksum = hash64(out.data() + sizeof(header), header.size);
+    std::memcpy(&out[0], &header, sizeof(header));
+
+    std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+    file.write(out.data(), out.size());
+    return static_cast<bool>(file.flush());
+}
+
+InstructionView Image::instructions() const{
+    return InstructionView(reinterpret_cast<const Instruction*>(payload), count);
+}
+
+InstructionView Image::fused() const{
+    return InstructionView(reinterpret_cast<const Instruction*>(payload) + count, count);
+}
+
+std::vector<Number> Image::constants() const{
+    const Number *begin = reinterpret_cast<const Number*>(payload + 2 * count * sizeof(Instruction));
+    return std::vector<Number>(begin, begin + constantCount);
+}
+
+std::string_view Image::source() const{
+    const char *begin = payload + 2 * count * sizeof(Instruction) + constantCount * sizeof(Number);
+    return std::string_view(begin, sourceLength);
+}
+
+std::string_view Image::strings() const{
+    const char *begin = payload + 2 * count * sizeof(Instruction) + constantCount * sizeof(Number) +
+                        padded(sourceLength);
+    return std::string_view(begin, stringsSize);
+}
+
+std::string_view Image::lines() const{
+    const char *begin = payload + 2 * count * sizeof(Instruction) + constantCount * sizeof(Number) +
+                        padded(sourceLength) + padded(stringsSize);
+    return std::string_view(begin, linesSize);
+}
+
+void Image::close(){
+#ifndef _WIN32
+    if (mapping)
+        munmap(mapping, mappingSize);
+#endif
+    mapping = nullptr;
+    mappingSize = 0;
+    buffer.clear();
+    payload = nullptr;
+    count = constantCount = sourceLength = stringsSize = linesSize = 0;
+}
@@ -0,0 +1,80 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "Number.h"
+#include "Opcodes.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A program compiled with --compile: the decoded and the fused instructions,
+// the constants of the fused ones, the parsed source (for -d and --profile),
+// the string table and the line table. It is mapped in memory and run as it is, without parsing anything.
+//
+// The arrays are stored the way this build lays them out in memory, so an
+// image only loads in a build with the same layout and byte order; the
+// header records both, and a checksum catches damaged or truncated files.
+class Image{
+public:
+    enum class Result {Loaded, NotImage, Invalid};
+
+    Image() = default;
+    ~Image();
+
+    Image(const Image&) = delete;
+    Image &operator=(const Image&) = delete;
+
+    // NotImage if the file doesn't start like an image (or can't be read)
+    Result open(const std::string &path);
+    const std::string &error() const;
+
+    static bool write(const std::string &path, InstructionView instructions, InstructionView fused,
+                      const std::vector<Number> &constants, std::string_view source,
+                      const std::string &strings, const std::string &lines);
+
+    bool loaded() const{
+        return payload != nullptr;
+    }
+
+    InstructionView instructions() const;
+    InstructionView fused() const;
+    std::vector<Number> constants() const;
+    std::string_view source() const;
+    std::string_view strings() const;   // StringTable::serialize()
+    std::string_view lines() const;     // LineTable::serialize()
+
+private:
+    void close();
+
+    void *mapping = nullptr;
+    std::size_t mappingSize = 0;
+    const char *payload = nullptr;      // what follows the header
+    std::size_t count = 0;              // instructions
+    std::size_t constantCount = 0;
+    std::size_t sourceLength = 0;
+    std::size_t stringsSize = 0;
+    std::size_t linesSize = 0;
+    std::vector<std::uint64_t> buffer;  // when the file can't be mapped
+    std::string message;
+};
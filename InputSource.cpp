@@ -0,0 +1,285 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "InputSource.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+bool isSpace(char ch){
+    return (ch == ' ') || (ch == '\t') || (ch == '\n') || (ch == '\v') || (ch == '\f') || (ch == '\r');
+}
+
+// Same rules as std::istream >> Number: leading whitespace, an optional sign
+// (a negative number wraps around) and at least one digit. Anything after the
+// digits is ignored. Returns false if there is no number or it doesn't fit.
+bool parseNumber(const char *begin, const char *end, Number &number){
+    while ((begin != end) && isSpace(*begin))
+        ++begin;
+
+    bool negative = false;
+    if ((begin != end) && ((*begin == '+') || (*begin == '-'))){
+        negative = *begin == '-';
+        ++begin;
+    }
+
+    if ((begin == end) || (*begin < '0') || (*begin > '9'))
+        return false;
+
+    const Number max = std::numeric_limits<Number>::max();
+    Number value = 0;
+    for (; (begin != end) && (*begin >= '0') && (*begin <= '9'); ++begin){
+        Number digit = *begin - '0';
+        if (value > (max - digit) / 10)
+            return false;
+        value = value * 10 + digit;
+    }
+
+    number = negative ? Number(0) - value : value;
+    return true;
+}
+
+}
+
+InputSource::InputSource(int fd, std::size_t capacity):
+fd          (fd),
+tied        (nullptr),
+storage     (capacity),
+cursor      (storage.data()),
+limit       (storage.data()),
+received    (0),
+mapping     (nullptr),
+mappingSize (0),
+terminal    (isatty(fd) != 0),
+fed         (false),
+closed      (false),
+hungry      (false){
+}
+
+InputSource::~InputSource(){
+    release();
+}
+
+bool InputSource::map(){
+#ifdef _WIN32
+    return false;
+#else
+    struct stat info;
+    if ((fstat(fd, &info) != 0) || !S_ISREG(info.st_mode))
+        return false;
+
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+    if ((offset < 0) || (offset > info.st_size))
+        return false;
+
+    std::size_t size = info.st_size;
+    if (size == 0)
+        return true; // nothing to map, reading returns the end right away
+
+    std::uint64_t taken = position();
+
+    void *memory = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (memory == MAP_FAILED)
+        return false;
+
+    release();
+    mapping = memory;
+    mappingSize = size;
+
+    // whatever was already read ahead comes first in the file anyway
+    const char *data = static_cast<const char*>(memory);
+    cursor = data + offset - (limit - cursor);
+    limit = data + size;
+    received = taken + (limit - cursor);
+    lseek(fd, 0, SEEK_END);
+    return true;
+#endif
+}
+
+void InputSource::assign(std::string_view data){
+    release();
+    fd = -1;
+    reader = nullptr;
+    terminal = false;
+    fed = false;
+    cursor = data.data();
+    limit = data.data() + data.size();
+    received = data.size();
+}
+
+void InputSource::assign(Reader reader){
+    release();
+    fd = -1;
+    this->reader = std::move(reader);
+    terminal = false;
+    fed = false;
+    cursor = limit = storage.data();
+    received = 0;
+}
+
+void InputSource::assignFed(){
+    release();
+    fd = -1;
+    reader = nullptr;
+    terminal = false;
+    fed = true;
+    closed = false;
+    hungry = false;
+    cursor = limit = storage.data();
+    received = 0;
+}
+
+void InputSource::feed(std::string_view data){
+    std::size_t pending = limit - cursor;
+    if (pending + data.size() > storage.size()){
+        std::vector<char> bigger(std::max(storage.size() * 2, pending + data.size()));
+        std::memcpy(bigger.data(), cursor, pending);
+        storage.swap(bigger);
+    } else{
+        std::memmove(storage.data(), cursor, pending);
+    }
+
+    std::memcpy(storage.data() + pending, data.data(), data.size());
+    cursor = storage.data();
+    limit = cursor + pending + data.size();
+    received += data.size();
+    hungry = false;
+}
+
+void InputSource::close(){
+    closed = true;
+    hungry = false;
+}
+
+void InputSource::tie(OutputSink *output){
+    tied = output;
+}
+
+Number InputSource::readNumber(){
+    for (;;){
+        const char *newline = static_cast<const char*>(std::memchr(cursor, '\n', limit - cursor));
+        while (!newline){
+            std::size_t scanned = limit - cursor;
+            if (!fill()){
+                if (hungry || (cursor == limit))
+                    return Number(0); // a partial line stays for later
+                newline = limit; // the last line has no '\n'
+                break;
+            }
+            newline = static_cast<const char*>(std::memchr(cursor + scanned, '\n', limit - cursor - scanned));
+        }
+
+        Number number;
+        bool found = parseNumber(cursor, newline, number);
+        cursor = (newline == limit) ? limit : newline + 1;
+        if (found)
+            return number;
+    }
+}
+
+void InputSource::sync(){
+    if (terminal)
+        cursor = limit;
+}
+
+bool InputSource::fill(){
+    if (fed){
+        hungry = !closed;
+        return false;
+    }
+    if (mapping || ((fd < 0) && !reader))
+        return false;
+
+    // keeps the unread bytes (a partial line) at the beginning
+    std::size_t pending = limit - cursor;
+    std::memmove(storage.data(), cursor, pending);
+    if (pending == storage.size())
+        storage.resize(storage.size() * 2);
+    cursor = storage.data();
+    limit = cursor + pending;
+
+    if (tied)
+        tied->flush();
+
+    if (reader){
+        std::size_t count = reader(storage.data() + pending, storage.size() - pending);
+        limit += count;
+        received += count;
+        return count > 0;
+    }
+
+    for (;;){
+#ifdef _WIN32
+        auto count = _read(fd, storage.data() + pending, static_cast<unsigned int>(storage.size() - pending));
+#else
+        auto count = ::read(fd, storage.data() + pending, storage.size() - pending);
+#endif
+        if ((count < 0) && (errno == EINTR))
+            continue;
+        if (count <= 0)
+            return false;
+
+        limit += count;
+        received += count;
+        return true;
+    }
+}
+
+void InputSource::skip(std::uint64_t count){
+    for (;;){
+        std::size_t buffered = limit - cursor;
+        if (count <= buffered){
+            cursor += count;
+            return;
+        }
+        cursor = limit;
+        count -= buffered;
+
+#ifndef _WIN32
+        if ((fd >= 0) && !mapping && (lseek(fd, count, SEEK_CUR) >= 0)){
+            received += count;
+            return;
+        }
+#endif
+        if (!fill())
+            return;
+    }
+}
+
+void InputSource::release(){
+#ifndef _WIN32
+    if (mapping)
+        munmap(mapping, mappingSize);
+#endif
+    mapping = nullptr;
+    mappingSize = 0;
+}
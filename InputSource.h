@@ -0,0 +1,111 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "Number.h"
+#include "OutputSink.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+// Where ReadN and ReadC take their input from. The file descriptor is read
+// in large blocks; a regular file can also be mapped in memory as a whole.
+// Instead of a file descriptor it can also read from a buffer in memory, from
+// a callback, or from whatever the caller feeds it without ever waiting.
+class InputSource{
+public:
+    static const std::size_t defaultCapacity = 64 * 1024;
+
+    // fills up to size bytes of data and returns how many, 0 at the end
+    typedef std::function<std::size_t(char *data, std::size_t size)> Reader;
+
+    explicit InputSource(int fd = 0, std::size_t capacity = defaultCapacity);
+    ~InputSource();
+
+    InputSource(const InputSource&) = delete;
+    InputSource &operator=(const InputSource&) = delete;
+
+    // maps the file instead of reading it (false if it isn't a regular file)
+    bool map();
+
+    // Reads from memory that has to outlive the InputSource, or from a
+    // callback, from now on. Anything read ahead is dropped.
+    void assign(std::string_view data);
+    void assign(Reader reader);
+
+    // Takes only what feed() gives it from now on. Running out of bytes
+    // isn't the end of the input until close(): a read that needs more
+    // returns 0 and leaves starved() set, without taking anything, so it can
+    // be repeated once more bytes are fed.
+    void assignFed();
+    void feed(std::string_view data);
+    void close();
+    bool starved() const{
+        return hungry;
+    }
+
+    // flushed before waiting for more input, so prompts are visible
+    void tie(OutputSink *output);
+
+    // 0 at the end of the input
+    Number readChar(){
+        if ((cursor == limit) && !fill())
+            return Number(0);
+        return static_cast<Number>(*cursor++);
+    }
+
+    // Takes a whole line and reads an unsigned number at its beginning,
+    // like std::istream >> Number. Lines without a number are skipped.
+    // 0 at the end of the input.
+    Number readNumber();
+
+    // drops what was typed ahead on a terminal (Opcodes::Reset)
+    void sync();
+
+    // Bytes taken so far, and skipping them again to go on from a
+    // checkpoint (Checkpoint.h): seeking if the file allows it, reading
+    // otherwise.
+    std::uint64_t position() const{
+        return received - (limit - cursor);
+    }
+    void skip(std::uint64_t count);
+
+private:
+    bool fill();
+
+    void release();
+
+    int fd;                 // -1 for memory and callbacks
+    Reader reader;
+    OutputSink *tied;
+    std::vector<char> storage;
+    const char *cursor;
+    const char *limit;
+    std::uint64_t received;     // bytes that came into [cursor, limit) so far
+    void *mapping;
+    std::size_t mappingSize;
+    bool terminal;
+    bool fed;
+    bool closed;
+    bool hungry;
+};
@@ -1,450 +1,794 @@
-/*
-DStack - Interpreter for the esoteric programming language DStack.
-Copyright (C) 2015 Alejandro O. Coria Bayer
-
-This program is free software; you can redistribute it and/or
-modify it under the terms of the GNU General Public License
-as published by the Free Software Foundation; either version 2
-of the License, or (at your option) any later version.
-
-This program is distributed in the hope that it will be useful,
-but WITHOUT ANY WARRANTY; without even the implied warranty of
-MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-GNU General Public License for more details.
-
-You should have received a copy of the GNU General Public License
-along with this program; if not, write to the Free Software
-Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
-*/
-
-#include "Interpreter.h"
-
-#include <algorithm>
-#include <chrono>
-#include <fstream>
-#include <iostream>
-#include <sstream>
-
-namespace {
-
-bool toLower(char &ch){
-    if ((ch >= 'A') && (ch <= 'Z')){
-        ch = ch - 'A' + 'a';
-        return true;
-    }
-    return false;
-}
-
-void printNumber(Number n){
-    std::cout << " " << toString(n);
-    char ch = toChar(n);
-    if ((ch >= 32) && (ch <= 126)) // is printable
-        std::cout << " (" << ch << ")";
-}
-
-void printStack(const Stack &stack){
-    bool first = true;
-    for (Number n : stack){
-        if (first)
-            first = false;
-        else
-            std::cout << ",";
-        printNumber(n);
-    }
-    std::cout << "\n";
-}
-
-void printLine(unsigned int n, char ch = '-'){
-    for (unsigned int i = 0; i < n; ++i)
-        std::cout << ch;
-}
-
-template<class T>
-std::string interpolate(std::string s, const T &n1, const T &n2){
-    std::string::size_type pos;
-
-    while ((pos = s.find("#")) != std::string::npos)
-        s.replace(pos, 1, std::string() + n1);
-
-    while ((pos = s.find("$")) != std::string::npos)
-        s.replace(pos, 1, std::string() + n2);
-
-    return s;
-}
-
-void pushString(const std::string &s, Stack &stack){
-    for (char ch : s)
-        stack.push_back(Number(ch));
-}
-
-}
-
-Interpreter::Interpreter(bool debug):
-reg         (0),
-pos         (0),
-status      (Status::Normal),
-debugMode   (debug),
-randomEngine(std::chrono::high_resolution_clock::now().time_since_epoch().count()){
-	stackA.push_back(Number(0));
-	stackB.push_back(Number(0));
-}
-
-bool Interpreter::load(const std::string &path){
-	std::ifstream t(path.c_str());
-	if (t){
-		std::stringstream buffer;
-		buffer << t.rdbuf();
-		source = buffer.str();
-		source += '\n';
-		parse();
-		if (status == Status::Error){
-            showError();
-            return false;
-		} else{
-            return true;
-		}
-	}
-
-	std::cout << "The file could not be opened (" + path + ")";
-	return false;
-}
-
-bool Interpreter::execute(){
-    if (sourceParsed.empty())
-        return true;
-
-	std::pair<char, char> pair;
-	Stack *first;
-	Stack *second;
-	do {
-		first = &stackA;
-		second = &stackB;
-
-        if (debugMode)
-            printCurrentStatus();
-
-		if (!getPair(pair))
-			continue;
-
-        toLower(pair.first);
-        bool alt = toLower(pair.second);
-
-        Opcodes code = toOpcode(pair, alt);
-
-        if (debugMode)
-            printCurrentOpcode(code, alt);
-
-        bool increment;
-		if (alt)
-            increment = execute(pair, code, *second, *first);
-        else
-            increment = execute(pair, code, *first, *second);
-
-        if (increment)
-            ++pos;
-	} while (status == Status::Normal);
-
-    if (status == Status::Error)
-        showError();
-
-	return status != Status::Error;
-}
-
-namespace {
-enum class Stage {Code, Comment, StringBegin, String, StringEnd, MultiComment, MultiCommentEnd};
-}
-
-bool Interpreter::parse(){
-    const std::string valids = "dstackDSTACK0123456789";
-    const std::string ignorable = " \t\n\r";
-
-    std::string::size_type line = 1;
-    std::string::size_type col = 1;
-    Number position = 0;
-    std::string stringLiteral;
-    Number stringId;
-
-    PositionInfo atPosition;
-
-    Stage stage = Stage::Code;
-
-    for (char ch : source){
-        switch (stage){
-            case Stage::Code:
-                if (ignorable.find(ch) != std::string::npos){
-                    // nothing to do
-                } else if (ch == '/'){
-                    stage = Stage::Comment;
-                } else if (valids.find(ch) != std::string::npos){
-                    sourceParsed += ch;
-                    positionMap.emplace(position, PositionInfo{line, col});
-                    ++position;
-                } else if ((ch == '@') && (col == 1)){
-                    stage = Stage::StringBegin;
-                    stringLiteral.clear();
-                    stringId = 0;
-                    atPosition.line = line;
-                    atPosition.col = col;
-                } else{
-                    status = Status::Error;
-                    errorInfo.position = {line, col};
-                    errorInfo.error = "Invalid character: ";
-                    errorInfo.error += ch;
-                }
-                break;
-            case Stage::Comment:
-                if (ch == '\n')
-                    stage = Stage::Code;
-                break;
-            case Stage::StringBegin:
-                if (ch == '\n'){
-                    if (col == 2){
-                        stage = Stage::MultiComment;
-                    } else{
-                        stage = Stage::String;
-                    }
-                } else{
-                    if (isDigit(ch)){
-                        stringId = stringId * 10 + (ch - '0');
-                    } else{
-                        status = Status::Error;
-                        errorInfo.position = {line, col};
-                        errorInfo.error = "Invalid character: ";
-                        errorInfo.error += ch;
-                        errorInfo.error += " (Only digits are allowed)";
-                    }
-                }
-                break;
-            case Stage::String:
-            case Stage::MultiComment:
-                if ((ch == '@') && (col == 1)){
-                    if (stage == Stage::String)
-                        stage = Stage::StringEnd;
-                    else
-                        stage = Stage::MultiCommentEnd;
-                } else{
-                    if (stage == Stage::String)
-                        strings[stringId] += ch;
-                }
-                break;
-            case Stage::StringEnd:
-            case Stage::MultiCommentEnd:
-                if (ch == '\n'){
-                    if (stage == Stage::StringEnd){
-                        strings[stringId].pop_back();
-                    }
-                    stage = Stage::Code;
-                } else{
-                    if (stage == Stage::StringEnd){
-                        strings[stringId] += '@';
-                        strings[stringId] += ch;
-                        stage = Stage::String;
-                    } else{
-                        stage = Stage::MultiComment;
-                    }
-                }
-                break;
-        }
-
-        ++col;
-        if (ch == '\n'){
-            ++line;
-            col = 1;
-        }
-
-        if (status == Status::Error)
-            break;
-    }
-
-    if (stage == Stage::MultiComment){
-        status = Status::Error;
-        errorInfo.position = atPosition;
-        errorInfo.error = "The comment is not closed before the end of file. Start";
-    } else if (stage == Stage::String){
-        status = Status::Error;
-        errorInfo.position = atPosition;
-        errorInfo.error = "The string literal is not closed before the end of file. Start";
-    }
-
-    return status != Status::Error;
-}
-
-bool Interpreter::getPair(std::pair<char, char> &pair){
-	if (pos >= sourceParsed.length() - 1){
-		status = Status::EoF;
-		return false;
-	}
-
-	pair = {sourceParsed[pos], sourceParsed[pos + 1]};
-	return true;
-}
-
-bool Interpreter::execute(std::pair<char, char> pair, Opcodes code, Stack &first, Stack &second){
-    bool increment = true;
-
-	switch (code) {
-	    case Opcodes::Digit:    reg = concat(pair.second, reg); break;
-	    case Opcodes::Error:    status = Status::Error; break;
-
-	    case Opcodes::None:     break;
-
-        case Opcodes::Add:      reg = first.back() + second.back(); break;
-        case Opcodes::Mul:      reg = first.back() * second.back(); break;
-        case Opcodes::Sub:      reg = first.back() - second.back(); break;
-        case Opcodes::Pow:      reg = std::pow(first.back(), second.back()); break;
-        case Opcodes::Div:      if (second.back() == 0){
-                                    status = Status::Error;
-                                    errorInfo.position = positionMap[pos];
-                                    errorInfo.error = "Division by zero";
-                                } else
-                                    reg = first.back() / second.back();
-                                break;
-        case Opcodes::Rem:      if (second.back() == 0){
-                                    status = Status::Error;
-                                    errorInfo.position = positionMap[pos];
-                                    errorInfo.error = "Division by zero (remainder operation)";
-                                } else
-                                    reg = first.back() % second.back();
-                                break;
-
-        case Opcodes::Zero:     reg = 0; break;
-
-        case Opcodes::Equal:    reg = first.back() == second.back(); break;
-        case Opcodes::Unequal:  reg = first.back() != second.back(); break;
-        case Opcodes::BetweenI:{Number min = std::min(first.back(), second.back());
-                                Number max = std::max(first.back(), second.back());
-                                reg = (min <= reg) && (reg <= max);
-                                } break;
-        case Opcodes::BetweenE:{Number min = std::min(first.back(), second.back());
-                                Number max = std::max(first.back(), second.back());
-                                reg = (min < reg) && (reg < max);
-                                } break;
-        case Opcodes::Greater:  reg = first.back() > second.back(); break;
-        case Opcodes::GreOrEq:  reg = first.back() >= second.back(); break;
-        case Opcodes::Not:      reg = !first.back(); break;
-        case Opcodes::And:      reg = Number(first.back() && second.back()); break;
-        case Opcodes::Or:       reg = Number(first.back() || second.back()); break;
-        case Opcodes::Xor:      reg = Number(!first.back() != !second.back()); break;
-
-        case Opcodes::Rand:     if (first.back() <= second.back())
-                                    reg = getRandom(first.back(), second.back());
-                                break;
-        case Opcodes::Min:      reg = std::min(first.back(), second.back()); break;
-        case Opcodes::Max:      reg = std::max(first.back(), second.back()); break;
-
-        case Opcodes::Push:     first.push_back(reg); break;
-        case Opcodes::PushS:    if (strings.count(reg))
-                                    pushString(strings[reg], first);
-                                break;
-        case Opcodes::PushRS:   if (strings.count(reg)){
-                                    std::string tmp = strings[reg];
-                                    std::reverse(tmp.begin(), tmp.end());
-                                    pushString(tmp, first);
-                                }
-                                break;
-        case Opcodes::Send:     second.push_back(first.back());
-                                first.pop_back();
-                                if (first.empty())
-                                    first.push_back(0);
-                                break;
-        case Opcodes::Peek:     reg = first.back(); break;
-        case Opcodes::Pop:      first.pop_back();
-                                if (first.empty())
-                                    first.push_back(0);
-                                break;
-        case Opcodes::Swap:     std::swap(first.back(), second.back()); break;
-
-        case Opcodes::Save:     first.push_back(pos + 1); break;
-        case Opcodes::Jump:     if (reg){
-                                    pos = first.back();
-                                    increment = false;
-                                }
-                                break;
-        case Opcodes::Reset:    if (reg){
-                                    pos = 0;
-                                    reg = 0;
-                                    stackA.clear(); stackA.push_back(0);
-                                    stackB.clear(); stackB.push_back(0);
-                                    std::cin.clear();
-                                    std::cin.sync();
-                                    debugOutput.clear();
-                                    increment = false;
-                                }
-                                break;
-        case Opcodes::Halt:     if (reg)
-                                     // halts the program because no program
-                                     // is going to have such a high position
-                                    pos = -1;
-                                    increment = false;
-                                break;
-
-        case Opcodes::PrintN:   print(toString(reg)); break;
-        case Opcodes::PrintC:   print(toChar(reg)); break;
-        case Opcodes::PrintS:   if (strings.count(reg))
-                                    print(strings[reg]);
-                                break;
-        case Opcodes::PrintSiN: if (strings.count(reg))
-                                    print(interpolate(strings[reg],
-                                          toString(first.back()), toString(second.back())));
-                                break;
-        case Opcodes::PrintSiC: if (strings.count(reg))
-                                    print(interpolate(strings[reg],
-                                          toChar(first.back()), toChar(second.back())));
-                                break;
-        case Opcodes::ReadN:    reg = readNumber(std::cin); break;
-        case Opcodes::ReadC:    reg = readChar(std::cin); break;
-	}
-
-	return increment;
-}
-
-Number Interpreter::getRandom(Number min, Number max){
-    return std::uniform_int_distribution<Number>{min, max}(randomEngine);
-}
-
-template<class T>
-void Interpreter::print(const T &output){
-    if (debugMode)
-        debugOutput += output;
-    else
-        std::cout << output;
-}
-
-void Interpreter::printCurrentStatus(){
-    std::cout << "stack 1:";
-    printStack(stackA);
-
-    std::cout << "stack 2:";
-    printStack(stackB);
-
-    std::cout << "register:";
-    printNumber(reg);
-    std::cout << "\n";
-
-    if (!debugOutput.empty())
-        std::cout << "output: " << debugOutput << "\n";
-
-    printLine(79);
-    std::cout << "\n";
-}
-void Interpreter::printCurrentOpcode(Opcodes code, bool alt){
-    std::cout << "instruction: " << toString(code);
-    std::cout << " (" << sourceParsed[pos] << sourceParsed[pos + 1] << ")";
-    if (alt)
-        std::cout << " stacks swapped";
-    std::cout << "\n";
-
-    std::cout << "position: " << pos << "\n";
-
-    printLine(79);
-    std::cout << "\n";
-}
-
-void Interpreter::showError(){
-    printLine(79, '*');
-    std::cout << "\n";
-    std::cout << errorInfo.error << " in ";
-    std::cout << errorInfo.position.line << ":" << errorInfo.position.col << "\n";
-    printLine(79, '*');
-    std::cout << "\n";
-}
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Interpreter.h"
+#include "Files.h"
+#include "Fusion.h"
+#include "Jit.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+bool toLower(char &ch){
+    if ((ch >= 'A') && (ch <= 'Z')){
+        ch = ch - 'A' + 'a';
+        return true;
+    }
+    return false;
+}
+
+void printNumber(std::ostream &out, Number n){
+    out << " " << toString(n);
+    char ch = toChar(n);
+    if ((ch >= 32) && (ch <= 126)) // is printable
+        out << " (" << ch << ")";
+}
+
+void printStack(std::ostream &out, const Stack &stack){
+    for (std::size_t i = 0; i < stack.size(); ++i){
+        if (i > 0)
+            out << ",";
+        printNumber(out, stack[i]);
+    }
+    out << "\n";
+}
+
+// what decode() and fuse() can produce, checked once when an image is
+// loaded because the engines index their tables with these fields
+bool validOpcode(Opcodes code, bool fused){
+    switch (code){
+        case Opcodes::Digit:    case Opcodes::Error:    case Opcodes::None:
+        case Opcodes::Add:      case Opcodes::Mul:      case Opcodes::Sub:
+        case Opcodes::Pow:      case Opcodes::Div:      case Opcodes::Rem:
+        case Opcodes::Zero:
+        case Opcodes::Equal:    case Opcodes::Unequal:  case Opcodes::BetweenI:
+        case Opcodes::BetweenE: case Opcodes::Greater:  case Opcodes::GreOrEq:
+        case Opcodes::Not:      case Opcodes::And:      case Opcodes::Or:
+        case Opcodes::Xor:
+        case Opcodes::Rand:     case Opcodes::Min:      case Opcodes::Max:
+        case Opcodes::Push:     case Opcodes::PushS:    case Opcodes::PushRS:
+        case Opcodes::Send:     case Opcodes::Peek:     case Opcodes::Pop:
+        case Opcodes::Swap:
+        case Opcodes::Save:     case Opcodes::Jump:     case Opcodes::Reset:
+        case Opcodes::Halt:
+        case Opcodes::PrintN:   case Opcodes::PrintC:   case Opcodes::PrintS:
+        case Opcodes::PrintSiN: case Opcodes::PrintSiC: case Opcodes::ReadN:
+        case Opcodes::ReadC:
+            return true;
+        case Opcodes::Digits:   case Opcodes::Constant: case Opcodes::PushConst:
+        case Opcodes::PeekPop:
+            return fused;
+    }
+    return false;
+}
+
+bool validInstructions(InstructionView instructions, bool fused, std::size_t constants){
+    for (std::size_t i = 0; i < instructions.size(); ++i){
+        const Instruction &instruction = instructions[i];
+        std::uint8_t alt;
+        std::memcpy(&alt, &instruction.alt, 1); // any byte but 0 and 1 is not a bool
+        if (!validOpcode(instruction.code, fused) || (alt > 1))
+            return false;
+        if ((instruction.code == Opcodes::Digit) && (instruction.digit > 9))
+            return false;
+        if (fused ? ((instruction.length == 0) || (instruction.length > instructions.size() - i))
+                  : (instruction.length != 1))
+            return false;
+        switch (instruction.code){
+            case Opcodes::Digits:
+            case Opcodes::Constant:
+            case Opcodes::PushConst:    if (instruction.constant >= constants)
+                                            return false;
+                                        break;
+            default:                    break;
+        }
+    }
+    return true;
+}
+
+void printLine(std::ostream &out, unsigned int n, char ch = '-'){
+    for (unsigned int i = 0; i < n; ++i)
+        out << ch;
+}
+
+}
+
+Interpreter::Interpreter(bool debug):
+reg         (0),
+pos         (0),
+loaded      (std::make_shared<Program>()),
+status      (Status::Normal),
+debugMode   (debug),
+engine      (Engine::Switch),
+output      (debug ? OutputSink::memory() : OutputSink()),
+steps       (0),
+nextCheck   (0),
+sliceEnd    (0),
+sliceTimed  (false),
+checkpointer(0),
+messages    (nullptr){
+	input.tie(&output);
+}
+
+Interpreter::~Interpreter(){
+    finishCheckpoint();
+}
+
+bool Interpreter::load(const std::string &path){
+    auto loading = std::make_shared<Program>();
+    switch (loading->image.open(path)){
+        case Image::Result::Loaded:     return loadImage(path, loading);
+        case Image::Result::Invalid:    report("The image could not be loaded (" + path + "): " + loading->image.error());
+                                        return false;
+        case Image::Result::NotImage:   break;
+    }
+
+	if (readFile(path, source, std::ios::in))
+        return parseSource(loading);
+
+	report("The file could not be opened (" + path + ")");
+	return false;
+}
+
+bool Interpreter::loadSource(std::string_view text){
+    source.assign(text.data(), text.size());
+    return parseSource(std::make_shared<Program>());
+}
+
+std::shared_ptr<const Program> Interpreter::program() const{
+    return loaded;
+}
+
+// the compiled code and the handlers are kept if it is the same program
+void Interpreter::setProgram(std::shared_ptr<const Program> program){
+    if (program == loaded)
+        return;
+    loaded = std::move(program);
+    jitCode.reset();
+    handlers.clear();
+    blockSlots.clear();
+    blockEntries.clear();
+}
+
+void Interpreter::reset(){
+    finishCheckpoint();
+    stackA.shrink();
+    stackB.shrink();
+    reg = 0;
+    pos = 0;
+    status = Status::Normal;
+    errorInfo = ErrorInfo();
+    steps = 0;
+    nextCheck = 0;
+    sliceEnd = 0;
+    sliceTimed = false;
+    journal.reset();
+    profile.reset();
+    lastMessage.clear();
+}
+
+bool Interpreter::parseSource(std::shared_ptr<Program> loading){
+    source += '\n';
+    if (parse(*loading))
+        decode(*loading);
+    std::string().swap(source); // only the parsed characters are needed now
+    if (status == Status::Error){
+        showError();
+        return false;
+    } else{
+        setProgram(std::move(loading));
+        return true;
+    }
+}
+
+// Everything comes from the image as it is, except the string and the line
+// tables and the constants, which only have their arrays copied. The
+// instructions are checked once here, as the parser checks the source.
+bool Interpreter::loadImage(const std::string &path, std::shared_ptr<Program> loading){
+    const Image &image = loading->image;
+    if (!loading->strings.deserialize(image.strings()) || !loading->lines.deserialize(image.lines())){
+        report("The image could not be loaded (" + path + "): its tables are damaged");
+        return false;
+    }
+
+    loading->instructions = image.instructions();
+    loading->fused = image.fused();
+    loading->constants = image.constants();
+    if (!validInstructions(loading->instructions, false, 0) ||
+        !validInstructions(loading->fused, true, loading->constants.size())){
+        report("The image could not be loaded (" + path + "): its instructions are damaged");
+        return false;
+    }
+    loading->sourceParsed.assign(image.source());
+    setProgram(std::move(loading));
+    return true;
+}
+
+// writes what load() produced as a program image (Image.h)
+bool Interpreter::compile(const std::string &path) const{
+    const Program &program = *loaded;
+    if (Image::write(path, program.instructions, program.fused, program.constants, program.sourceParsed,
+                     program.strings.serialize(), program.lines.serialize()))
+        return true;
+
+    report("The image could not be written (" + path + ")");
+    return false;
+}
+
+void Interpreter::setEngine(Engine engine){
+    this->engine = engine;
+}
+
+void Interpreter::setFlushPolicy(OutputSink::Flush policy){
+    if (!debugMode)
+        output.setPolicy(policy);
+}
+
+void Interpreter::setMessages(std::ostream *messages){
+    this->messages = messages;
+}
+
+void Interpreter::setInput(std::string_view data){
+    input.assign(data);
+}
+
+void Interpreter::setInput(InputSource::Reader reader){
+    input.assign(std::move(reader));
+}
+
+void Interpreter::setOutput(OutputSink::Writer writer){
+    if (!debugMode)
+        output = OutputSink(std::move(writer));
+}
+
+// the descriptor stays the caller's, to close after execute()
+void Interpreter::setOutput(int fd){
+    if (!debugMode)
+        output = OutputSink(fd);
+}
+
+void Interpreter::suspendOnInput(){
+    input.assignFed();
+}
+
+void Interpreter::feedInput(std::string_view data){
+    input.feed(data);
+}
+
+void Interpreter::closeInput(){
+    input.close();
+}
+
+void Interpreter::setLimits(const Limits &limits){
+    this->limits = limits;
+}
+
+void Interpreter::setRandom(Random::Generator generator, Number seed){
+    random = Random(generator, seed);
+}
+
+bool Interpreter::mapInput(){
+    return input.map();
+}
+
+bool Interpreter::record(const std::string &path){
+    journal.reset(new Journal);
+    if (journal->record(path))
+        return true;
+
+    journal.reset();
+    report("The journal could not be created (" + path + ")");
+    return false;
+}
+
+bool Interpreter::replay(const std::string &path){
+    journal.reset(new Journal);
+    if (journal->replay(path))
+        return true;
+
+    journal.reset();
+    report("The journal could not be read (" + path + ")");
+    return false;
+}
+
+bool Interpreter::execute(){
+    return run(0);
+}
+
+bool Interpreter::run(Number maxSteps, std::chrono::nanoseconds maxTime){
+    if (loaded->instructions.empty())
+        return true;
+
+    // a slice goes on with the same time limit, everything else starts it
+    bool resuming = status == Status::Yield;
+    if ((status == Status::Input) || (status == Status::Yield))
+        status = Status::Normal;
+
+    sliceEnd = maxSteps ? steps + maxSteps : 0;
+    sliceTimed = maxTime.count() > 0;
+    if (sliceTimed)
+        sliceDeadline = std::chrono::steady_clock::now() +
+                        std::chrono::duration_cast<std::chrono::steady_clock::duration>(maxTime);
+
+    if ((limits.seconds > 0) && !resuming){
+        auto timeout = std::chrono::duration<double>(limits.seconds);
+        deadline = std::chrono::steady_clock::now() +
+                   std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout);
+    }
+    nextCheck = steps; // right away
+
+    // the debugger and the profiler need to stop at every single step
+    if (debugMode || profile || (engine == Engine::Switch))
+        executeSwitch();
+    else if (engine == Engine::Threaded)
+        executeThreaded();
+    else if (engine == Engine::Blocks)
+        executeBlocks();
+    else
+        executeJit();
+
+    output.flush();
+    if (journal)
+        journal->flush();
+    if ((status == Status::Error) || (status == Status::Limit))
+        showError();
+
+	return (status != Status::Error) && (status != Status::Limit);
+}
+
+Number Interpreter::registerValue() const{
+    return reg;
+}
+
+const Stack &Interpreter::firstStack() const{
+    return stackA;
+}
+
+const Stack &Interpreter::secondStack() const{
+    return stackB;
+}
+
+const std::string &Interpreter::lastError() const{
+    return lastMessage;
+}
+
+bool Interpreter::limitReached() const{
+    return status == Status::Limit;
+}
+
+bool Interpreter::outputFailed() const{
+    return output.failed();
+}
+
+bool Interpreter::waitingForInput() const{
+    return status == Status::Input;
+}
+
+bool Interpreter::yielded() const{
+    return status == Status::Yield;
+}
+
+Number Interpreter::instructionsExecuted() const{
+    return steps;
+}
+
+void Interpreter::executeSwitch(){
+    // counts down to the next check, so the loop only touches a local
+    Number left = nextCheck - steps;
+    const InstructionView instructions = loaded->instructions;
+
+	do {
+        if (debugMode)
+            printCurrentStatus();
+
+		if (pos >= instructions.size()){
+			status = Status::EoF;
+			continue;
+		}
+
+        if (left == 0){
+            steps = nextCheck;
+            if (!checkLimits())
+                continue;
+            left = nextCheck - steps;
+        }
+
+        const Instruction &instruction = instructions[pos];
+        Number position = pos;
+
+        if (debugMode)
+            printCurrentOpcode(instruction);
+
+        bool increment;
+		if (instruction.alt)
+            increment = execute(instruction, stackB, stackA);
+        else
+            increment = execute(instruction, stackA, stackB);
+
+        if (increment)
+            ++pos;
+        --left;
+
+        if (profile && (status != Status::Input))
+            profileStep(position, instruction, !increment);
+	} while (status == Status::Normal);
+
+    steps = nextCheck - left;
+    if (status == Status::Input)
+        --steps; // it runs again once there is input
+}
+
+void Interpreter::decode(Program &loading){
+    const std::string &sourceParsed = loading.sourceParsed;
+    std::vector<Instruction> &decoded = loading.decoded;
+    if (sourceParsed.length() < 2)
+        return;
+
+    // every position starts a pair, and a jump can land on any of them
+    decoded.reserve(sourceParsed.length() - 1);
+    for (std::string::size_type i = 0; i + 1 < sourceParsed.length(); ++i){
+        std::pair<char, char> pair = {sourceParsed[i], sourceParsed[i + 1]};
+        toLower(pair.first);
+        bool alt = toLower(pair.second);
+
+        Instruction instruction;
+        instruction.code = toOpcode(pair, alt);
+        instruction.alt = alt;
+        instruction.digit = isDigit(pair.second) ? pair.second - '0' : 0;
+        instruction.length = 1;
+        instruction.constant = 0;
+        decoded.push_back(instruction);
+    }
+
+    loading.decodedFused = fuse(decoded, loading.constants);
+    loading.instructions = decoded;
+    loading.fused = loading.decodedFused;
+}
+
+bool Interpreter::execute(const Instruction &instruction, Stack &first, Stack &second){
+    bool increment = true;
+
+	switch (instruction.code) {
+	    case Opcodes::Digit:    reg = reg * 10 + instruction.digit; break;
+	    case Opcodes::Error:    status = Status::Error; break;
+
+	    case Opcodes::None:     pos += instruction.length - 1; break;
+
+        case Opcodes::Add:      reg = first.top() + second.top(); break;
+        case Opcodes::Mul:      reg = first.top() * second.top(); break;
+        case Opcodes::Sub:      reg = first.top() - second.top(); break;
+        case Opcodes::Pow:      reg = std::pow(first.top(), second.top()); break;
+        case Opcodes::Div:      if (second.top() == 0){
+                                    status = Status::Error;
+                                    errorInfo.position = positionOf(pos);
+                                    errorInfo.error = "Division by zero";
+                                } else
+                                    reg = first.top() / second.top();
+                                break;
+        case Opcodes::Rem:      if (second.top() == 0){
+                                    status = Status::Error;
+                                    errorInfo.position = positionOf(pos);
+                                    errorInfo.error = "Division by zero (remainder operation)";
+                                } else
+                                    reg = first.top() % second.top();
+                                break;
+
+        case Opcodes::Zero:     reg = 0; break;
+
+        case Opcodes::Equal:    reg = first.top() == second.top(); break;
+        case Opcodes::Unequal:  reg = first.top() != second.top(); break;
+        case Opcodes::BetweenI:{Number min = std::min(first.top(), second.top());
+                                Number max = std::max(first.top(), second.top());
+                                reg = (min <= reg) && (reg <= max);
+                                } break;
+        case Opcodes::BetweenE:{Number min = std::min(first.top(), second.top());
+                                Number max = std::max(first.top(), second.top());
+                                reg = (min < reg) && (reg < max);
+                                } break;
+        case Opcodes::Greater:  reg = first.top() > second.top(); break;
+        case Opcodes::GreOrEq:  reg = first.top() >= second.top(); break;
+        case Opcodes::Not:      reg = !first.top(); break;
+        case Opcodes::And:      reg = Number(first.top() && second.top()); break;
+        case Opcodes::Or:       reg = Number(first.top() || second.top()); break;
+        case Opcodes::Xor:      reg = Number(!first.top() != !second.top()); break;
+
+        case Opcodes::Rand:     if (first.top() <= second.top())
+                                    reg = getRandom(first.top(), second.top());
+                                break;
+        case Opcodes::Min:      reg = std::min(first.top(), second.top()); break;
+        case Opcodes::Max:      reg = std::max(first.top(), second.top()); break;
+
+        case Opcodes::Push:     first.push(reg); break;
+        case Opcodes::PushS:
+        case Opcodes::PushRS:   if (const StringTable::Entry *entry = loaded->strings.find(reg)){
+                                    const Number *values = loaded->strings.values(*entry, instruction.code == Opcodes::PushRS);
+                                    first.append(values, entry->length);
+                                }
+                                break;
+        case Opcodes::Send:     second.push(first.top());
+                                first.pop();
+                                break;
+        case Opcodes::Peek:     reg = first.top(); break;
+        case Opcodes::Pop:      first.pop();
+                                break;
+        case Opcodes::Swap:     std::swap(first.top(), second.top()); break;
+
+        case Opcodes::Save:     first.push(pos + 1); break;
+        case Opcodes::Jump:     if (reg){
+                                    pos = first.top();
+                                    increment = false;
+                                }
+                                break;
+        case Opcodes::Reset:    if (reg){
+                                    pos = 0;
+                                    reg = 0;
+                                    stackA.clear();
+                                    stackB.clear();
+                                    input.sync();
+                                    if (debugMode)
+                                        output.clear();
+                                    increment = false;
+                                }
+                                break;
+        case Opcodes::Halt:     if (reg)
+                                     // halts the program because no program
+                                     // is going to have such a high position
+                                    pos = -1;
+                                    increment = false;
+                                break;
+
+        case Opcodes::PrintN:   output.writeNumber(reg); break;
+        case Opcodes::PrintC:   print(toChar(reg)); break;
+        case Opcodes::PrintS:   if (const StringTable::Entry *entry = loaded->strings.find(reg))
+                                    print(loaded->strings.text(*entry));
+                                break;
+        case Opcodes::PrintSiN: if (const StringTable::Entry *entry = loaded->strings.find(reg))
+                                    printInterpolated(*entry, first.top(), second.top(), false);
+                                break;
+        case Opcodes::PrintSiC: if (const StringTable::Entry *entry = loaded->strings.find(reg)){
+                                    if (!printInterpolated(*entry, first.top(), second.top(), true))
+                                        increment = false; // never gets past it, see below
+                                }
+                                break;
+        case Opcodes::ReadN:    return read(Journal::Event::ReadN);
+        case Opcodes::ReadC:    return read(Journal::Event::ReadC);
+
+        case Opcodes::Digits:   reg = reg * powerOfTen(instruction.digit) + loaded->constants[instruction.constant];
+                                pos += instruction.length - 1;
+                                break;
+        case Opcodes::Constant: reg = loaded->constants[instruction.constant];
+                                pos += instruction.length - 1;
+                                break;
+        case Opcodes::PushConst:reg = loaded->constants[instruction.constant];
+                                first.push(reg);
+                                pos += instruction.length - 1;
+                                break;
+        case Opcodes::PeekPop:  reg = first.top();
+                                first.pop();
+                                pos += instruction.length - 1;
+                                break;
+	}
+
+	return increment;
+}
+
+Number Interpreter::getRandom(Number min, Number max){
+    return journal ? journaled(Journal::Event::Rand, min, max) : random.between(min, max);
+}
+
+// ReadN and ReadC. Without enough input yet (see suspendOnInput()) they
+// leave everything as it was and stop the program until it comes.
+bool Interpreter::read(Journal::Event event){
+    Number value;
+    if (journal)
+        value = journaled(event);
+    else if (event == Journal::Event::ReadN)
+        value = input.readNumber();
+    else
+        value = input.readChar();
+
+    if (input.starved()){
+        status = Status::Input;
+        return false;
+    }
+
+    reg = value;
+    return true;
+}
+
+// Takes the value from the journal when replaying one, and otherwise from the
+// input or the generator, writing it down.
+Number Interpreter::journaled(Journal::Event event, Number min, Number max){
+    Number value = 0;
+    if (journal->replaying()){
+        if (!journal->read(event, value)){
+            status = Status::Error;
+            errorInfo.position = positionOf(pos);
+            errorInfo.error = "The journal doesn't match this run";
+            return reg;
+        }
+        return value;
+    }
+
+    switch (event){
+        case Journal::Event::ReadN: value = input.readNumber(); break;
+        case Journal::Event::ReadC: value = input.readChar(); break;
+        case Journal::Event::Rand:  value = random.between(min, max); break;
+    }
+    if (!input.starved())
+        journal->write(event, value);
+    return value;
+}
+
+// Called by the engines once steps reaches nextCheck. Stops the program
+// (status Limit) if it went past one of its limits, or (status Yield) at the
+// end of a slice of run().
+bool Interpreter::checkLimits(){
+    // the clock is read more often when a slice depends on it
+    const Number checkInterval = sliceTimed ? 4 * 1024 : 64 * 1024;
+
+    const char *exceeded = nullptr;
+    if (limits.steps && (steps >= limits.steps))
+        exceeded = "Step limit reached";
+    else if (limits.depth && (std::max(stackA.size(), stackB.size()) > limits.depth))
+        exceeded = "Stack depth limit reached";
+    else if (limits.memory && (stackA.memory() + stackB.memory() > limits.memory))
+        exceeded = "Memory limit reached";
+    else if ((limits.seconds > 0) && (std::chrono::steady_clock::now() >= deadline))
+        exceeded = "Time limit reached";
+
+    if (exceeded){
+        status = Status::Limit;
+        errorInfo.error = exceeded;
+        errorInfo.position = positionOf(pos);
+        return false;
+    }
+
+    if ((sliceEnd && (steps >= sliceEnd)) ||
+        (sliceTimed && (std::chrono::steady_clock::now() >= sliceDeadline))){
+        status = Status::Yield;
+        return false;
+    }
+
+    nextCheck = steps + checkInterval;
+    if (limits.steps && (nextCheck > limits.steps))
+        nextCheck = limits.steps;
+    if (sliceEnd && (nextCheck > sliceEnd))
+        nextCheck = sliceEnd;
+    return true;
+}
+
+template<class T>
+void Interpreter::print(const T &text){
+    output.write(text);
+}
+
+// Every '#' is replaced by the first value and then every '$' by the second
+// one. With characters a value can be a placeholder itself: a '$' put in
+// place of a '#' gets replaced too, and a '#' for '#' (or '$' for '$') kept
+// the replacement loop going forever. Returns false in that last case,
+// without printing anything.
+bool Interpreter::printInterpolated(const StringTable::Entry &entry, Number n1, Number n2, bool characters){
+    typedef StringTable::Segment Segment;
+
+    std::string_view text = loaded->strings.text(entry);
+    const Segment *segments = loaded->strings.segments(entry);
+
+    char first[20];
+    char second[20];
+    std::size_t firstLength;
+    std::size_t secondLength;
+
+    if (characters){
+        first[0] = toChar(n1);
+        second[0] = toChar(n2);
+        firstLength = secondLength = 1;
+
+        bool usesFirst = entry.usesFirst;
+        bool usesSecond = entry.usesSecond;
+        if (first[0] == '$'){
+            usesSecond = usesSecond || usesFirst;
+            first[0] = second[0];
+        } else if ((first[0] == '#') && usesFirst){
+            return false;
+        }
+        if ((second[0] == '$') && usesSecond)
+            return false;
+    } else{
+        firstLength = std::to_chars(first, first + sizeof(first), n1).ptr - first;
+        secondLength = std::to_chars(second, second + sizeof(second), n2).ptr - second;
+    }
+
+    for (const Segment *segment = segments; segment != segments + entry.segmentCount; ++segment){
+        switch (segment->kind){
+            case Segment::Kind::Text:   output.write(text.data() + segment->offset, segment->length); break;
+            case Segment::Kind::First:  output.write(first, firstLength); break;
+            case Segment::Kind::Second: output.write(second, secondLength); break;
+        }
+    }
+    return true;
+}
+
+void Interpreter::printCurrentStatus(){
+    if (!messages)
+        return;
+    std::ostream &out = *messages;
+
+    out << "stack 1:";
+    printStack(out, stackA);
+
+    out << "stack 2:";
+    printStack(out, stackB);
+
+    out << "register:";
+    printNumber(out, reg);
+    out << "\n";
+
+    if (debugMode && !output.contents().empty())
+        out << "output: " << output.contents() << "\n";
+
+    printLine(out, 79);
+    out << "\n";
+}
+void Interpreter::printCurrentOpcode(const Instruction &instruction){
+    if (!messages)
+        return;
+    std::ostream &out = *messages;
+
+    out << "instruction: " << toString(instruction.code);
+    out << " (" << loaded->sourceParsed[pos] << loaded->sourceParsed[pos + 1] << ")";
+    if (instruction.alt)
+        out << " stacks swapped";
+    out << "\n";
+
+    out << "position: " << pos << "\n";
+
+    printLine(out, 79);
+    out << "\n";
+}
+
+// line and column of a parsed character, 0:0 past the end of the program
+Interpreter::PositionInfo Interpreter::positionOf(Number position) const{
+    PositionInfo info = {0, 0};
+    loaded->lines.find(position, info.line, info.col);
+    return info;
+}
+
+void Interpreter::showError(){
+    lastMessage = errorInfo.error + " in " + std::to_string(errorInfo.position.line) + ":" +
+                  std::to_string(errorInfo.position.col);
+    if (!messages)
+        return;
+
+    printLine(*messages, 79, '*');
+    *messages << "\n" << lastMessage << "\n";
+    printLine(*messages, 79, '*');
+    *messages << "\n";
+}
+
+void Interpreter::report(const std::string &message) const{
+    lastMessage = message;
+    if (messages)
+        *messages << message;
+}
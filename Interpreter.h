@@ -1,77 +1,212 @@
-/*
-DStack - Interpreter for the esoteric programming language DStack.
-Copyright (C) 2015 Alejandro O. Coria Bayer
-
-This program is free software; you can redistribute it and/or
-modify it under the terms of the GNU General Public License
-as published by the Free Software Foundation; either version 2
-of the License, or (at your option) any later version.
-
-This program is distributed in the hope that it will be useful,
-but WITHOUT ANY WARRANTY; without even the implied warranty of
-MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-GNU General Public License for more details.
-
-You should have received a copy of the GNU General Public License
-along with this program; if not, write to the Free Software
-Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
-*/
-
-#pragma once
-
-#include "Number.h"
-#include "Opcodes.h"
-
-#include <map>
-#include <random>
-#include <string>
-#include <utility>
-#include <vector>
-
-typedef std::vector<Number> Stack;
-
-class Interpreter{
-public:
-	Interpreter(bool debug = false);
-	bool load(const std::string &path);
-	bool execute();
-
-private:
-    bool parse();
-    bool getPair(std::pair<char, char> &pair);
-	bool execute(std::pair<char, char> pair, Opcodes code, Stack &first, Stack &second);
-	Number getRandom(Number min, Number max);
-
-	template<class T>
-	void print(const T &output);
-	void printCurrentStatus();
-	void printCurrentOpcode(Opcodes code, bool alt);
-
-	void showError();
-
-    enum class Status {Normal, EoF, Error};
-
-    struct PositionInfo{
-        std::string::size_type line;
-        std::string::size_type col;
-    };
-
-    struct ErrorInfo{
-        PositionInfo position;
-        std::string error;
-    };
-
-	Stack stackA;
-	Stack stackB;
-	Number reg;
-	Number pos;
-	std::map<Number, std::string> strings;
-	std::string source;
-	std::string sourceParsed;
-	std::map<Number, PositionInfo> positionMap;
-	Status status;
-	ErrorInfo errorInfo;
-	bool debugMode;
-	std::string debugOutput;
-	std::mt19937 randomEngine;
-};
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "InputSource.h"
+#include "Journal.h"
+#include "Number.h"
+#include "Opcodes.h"
+#include "OutputSink.h"
+#include "Program.h"
+#include "Random.h"
+#include "Stack.h"
+#include "StringTable.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+class JitCode;
+
+enum class Engine {Switch, Threaded, Blocks, Jit};
+
+// 0 means no limit. They are checked in batches (and the threaded, blocks
+// and JIT engines only at jumps), so a program can go a little past them.
+struct Limits{
+    Number steps = 0;           // instructions executed
+    std::size_t depth = 0;      // values in one stack
+    std::size_t memory = 0;     // bytes held by the two stacks
+    double seconds = 0;         // wall-clock time
+};
+
+// Runs one program. Everything an Interpreter uses is its own, so any number
+// of them can run at the same time on different threads. By default it reads
+// stdin, writes stdout and says nothing about errors: setMessages() picks the
+// stream for errors and debugging output, and lastError() keeps the last one.
+// The data given to setInput(std::string_view) is not copied, it has to
+// outlive the Interpreter. A loaded program can be handed to other
+// interpreters with program() and setProgram(), without parsing it again.
+//
+// After suspendOnInput() the input is only what feedInput() gives it, and
+// execute() returns as soon as ReadN or ReadC need more than that, with
+// waitingForInput() set. Nothing is lost: calling execute() again after
+// feeding more input (or closeInput(), the end of the input) goes on from
+// that same instruction.
+//
+// run() is execute() in slices: it returns, with yielded() set, after about
+// maxSteps instructions or maxTime, and the next call goes on from there.
+// The threaded, blocks and JIT engines only stop at jumps, so a slice can run a
+// little longer. Scheduler (Scheduler.h) takes turns between interpreters
+// with it.
+//
+// reset() takes it back to the start of the program for another run, with
+// empty stacks and no journal nor profile. The program, the settings and
+// the memory it already has are kept (input and output included, so give it
+// new ones), except stack buffers that grew past 1 MiB.
+class Interpreter{
+public:
+	Interpreter(bool debug = false);
+	~Interpreter();
+	void setEngine(Engine engine);
+	void setFlushPolicy(OutputSink::Flush policy);
+	void setMessages(std::ostream *messages);
+	void setInput(std::string_view data);
+	void setInput(InputSource::Reader reader);
+	void setOutput(OutputSink::Writer writer);
+	void setOutput(int fd);
+	void suspendOnInput();
+	void feedInput(std::string_view data);
+	void closeInput();
+	void setLimits(const Limits &limits);
+	void setRandom(Random::Generator generator, Number seed);
+	bool mapInput();
+	bool record(const std::string &path);
+	bool replay(const std::string &path);
+	bool load(const std::string &path);
+	bool loadSource(std::string_view text);
+	std::shared_ptr<const Program> program() const;
+	void setProgram(std::shared_ptr<const Program> program);
+	void reset();
+	bool compile(const std::string &path) const;
+	bool execute();
+	bool run(Number maxSteps, std::chrono::nanoseconds maxTime = std::chrono::nanoseconds::zero());
+	Number registerValue() const;
+	const Stack &firstStack() const;
+	const Stack &secondStack() const;
+	const std::string &lastError() const;
+	bool limitReached() const;
+	bool outputFailed() const;
+	bool waitingForInput() const;
+	bool yielded() const;
+	bool checkpoint(const std::string &path);
+	bool finishCheckpoint();
+	bool restore(const std::string &path);
+	Number instructionsExecuted() const;
+	void enableProfile();
+	void writeProfile(std::ostream &report, std::ostream &json) const;
+	void emitCpp(std::ostream &out) const;
+
+private:
+    bool parseSource(std::shared_ptr<Program> loading);
+    bool parse(Program &loading);
+    void decode(Program &loading);
+    bool loadImage(const std::string &path, std::shared_ptr<Program> loading);
+    void executeSwitch();
+    void executeThreaded();
+    void executeBlocks();
+    void executeJit();
+	bool execute(const Instruction &instruction, Stack &first, Stack &second);
+	Number getRandom(Number min, Number max);
+	bool read(Journal::Event event);
+	Number journaled(Journal::Event event, Number min = 0, Number max = 0);
+	bool checkLimits();
+	void profileStep(Number position, const Instruction &instruction, bool jumped);
+
+	template<class T>
+	void print(const T &text);
+	bool printInterpolated(const StringTable::Entry &entry, Number n1, Number n2, bool characters);
+	void printCurrentStatus();
+	void printCurrentOpcode(const Instruction &instruction);
+
+	void showError();
+	void report(const std::string &message) const;
+
+    enum class Status {Normal, EoF, Error, Limit, Input, Yield};
+
+    struct PositionInfo{
+        std::string::size_type line;
+        std::string::size_type col;
+    };
+
+    PositionInfo positionOf(Number position) const;
+
+    // executeBlocks(): one per instruction of every block, and one more at
+    // the end of each that falls through to the next block
+    struct BlockSlot{
+        void *handler;
+        const Instruction *instruction;
+        Stack *first;
+        Stack *second;
+        Number position;
+    };
+
+    struct ErrorInfo{
+        PositionInfo position;
+        std::string error;
+    };
+
+    // what --profile collects (InterpreterProfile.cpp)
+    struct Profile{
+        struct Edge{
+            Number target;
+            Number count;
+        };
+
+        std::vector<Number> counts;             // by position
+        std::vector<std::vector<Edge>> jumps;   // by position of the Jump
+        std::size_t highWater[2];
+    };
+
+	Stack stackA;
+	Stack stackB;
+	Number reg;
+	Number pos;
+	std::string source;             // only while loading
+	std::shared_ptr<const Program> loaded;
+	Status status;
+	ErrorInfo errorInfo;
+	bool debugMode;
+	Engine engine;
+	OutputSink output;
+	InputSource input;
+	Random random;
+	std::unique_ptr<Journal> journal;
+	Limits limits;
+	Number steps;           // instructions executed
+	Number nextCheck;       // when checkLimits() has to be called again
+	std::chrono::steady_clock::time_point deadline;
+	Number sliceEnd;        // steps at which run() yields, 0 if it doesn't
+	std::chrono::steady_clock::time_point sliceDeadline;
+	bool sliceTimed;
+	std::unique_ptr<JitCode> jitCode;   // kept from one execute() to the next
+	std::vector<void*> handlers;        // executeThreaded(), likewise
+	std::vector<BlockSlot> blockSlots;  // executeBlocks(), likewise
+	std::vector<std::uint32_t> blockEntries;    // by position, the first slot of the block starting there
+	int checkpointer;                   // process writing a checkpoint, 0 if none
+	std::string checkpointPath;
+	std::unique_ptr<Profile> profile;
+	std::ostream *messages;     // nowhere if null
+	mutable std::string lastMessage;
+};
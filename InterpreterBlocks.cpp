@@ -0,0 +1,250 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Interpreter.h"
+#include "ControlFlow.h"
+#include "Fusion.h"
+
+#include <algorithm>
+#include <vector>
+
+// The blocks engine: the fused program (Fusion.h) split in basic blocks
+// (ControlFlow.h), each one laid out as a run of slots with the address of
+// the handler of every instruction and its stacks already resolved. Inside
+// a block an instruction just goes on to the next slot; the position is
+// only looked at when a block is left. A jump checks that its target starts
+// a block and goes straight to it; when it doesn't, the instructions are
+// executed one position at a time until one that does.
+//
+// Instructions are counted and the limits checked at jumps, as in the
+// threaded engine (InterpreterThreaded.cpp), and the same instructions are
+// handed to Interpreter::execute(). It needs computed goto; other compilers
+// get the threaded engine instead.
+
+#if defined(__GNUC__) || defined(__clang__)
+
+#define DSTACK_BLOCK_OPCODES(X) \
+    X(Digit) X(Error) X(None) \
+    X(Add) X(Mul) X(Sub) X(Pow) X(Div) X(Rem) \
+    X(Zero) \
+    X(Equal) X(Unequal) X(BetweenI) X(BetweenE) X(Greater) X(GreOrEq) \
+    X(Not) X(And) X(Or) X(Xor) \
+    X(Rand) X(Min) X(Max) \
+    X(Push) X(PushS) X(PushRS) X(Send) X(Peek) X(Pop) X(Swap) \
+    X(Save) X(Jump) X(Reset) X(Halt) \
+    X(PrintN) X(PrintC) X(PrintS) X(PrintSiN) X(PrintSiC) X(ReadN) X(ReadC) \
+    X(Digits) X(Constant) X(PushConst) X(PeekPop)
+
+#define HANDLER(op) op_##op:
+#define DISPATCH() goto *slot->handler
+#define NEXT() ++slot; DISPATCH()
+
+#define FIRST (*slot->first)
+#define SECOND (*slot->second)
+
+// from the instruction at position from; everything since the last jump
+// target ran once
+#define JUMP(from, target) \
+    steps += (from) + 1 - segment; \
+    p = segment = (target); \
+    if (steps >= nextCheck){ \
+        reg = r; \
+        pos = p; \
+        if (!checkLimits()) \
+            goto end; \
+    } \
+    goto enter
+
+// hands the instruction to the switch engine, staying in the block if it
+// goes on to the next position
+#define DELEGATE() \
+    p = slot->position; \
+    reg = r; \
+    pos = p; \
+    if (execute(*slot->instruction, FIRST, SECOND)) \
+        ++pos; \
+    r = reg; \
+    if (status != Status::Normal) \
+        goto end; \
+    if (pos == p + 1){ \
+        NEXT(); \
+    } \
+    JUMP(p, pos)
+
+void Interpreter::executeBlocks(){
+    const Instruction *code = loaded->fused.data();
+    const Number *constants = loaded->constants.data();
+    const Number size = loaded->fused.size();
+
+    // the same for every call, as long as the program doesn't change
+    if (blockEntries.size() != size){
+        Stack *stacks[2] = {&stackA, &stackB};
+        ControlFlow flow = findBlocks(loaded->fused, loaded->constants);
+        blockSlots.clear();
+        blockEntries.assign(size, ControlFlow::noBlock);
+        for (const BasicBlock &block : flow.blocks){
+            blockEntries[block.start] = static_cast<std::uint32_t>(blockSlots.size());
+            for (Number i = block.start; i < block.end; i += code[i].length){
+                BlockSlot slot = {nullptr, &code[i], stacks[code[i].alt], stacks[!code[i].alt], i};
+                switch (code[i].code){
+                    #define LABEL(op) case Opcodes::op: slot.handler = &&op_##op; break;
+                    DSTACK_BLOCK_OPCODES(LABEL)
+                    #undef LABEL
+                }
+                blockSlots.push_back(slot);
+            }
+            blockSlots.push_back(BlockSlot{&&fallThrough, nullptr, nullptr, nullptr, block.end});
+        }
+    }
+    const BlockSlot *slots = blockSlots.data();
+    const std::uint32_t *entries = blockEntries.data();
+
+    // local copies, so the compiler can keep them in registers
+    Number r = reg;
+    Number p = pos;
+    Number segment = p;
+    const BlockSlot *slot;
+
+enter:
+    if (p >= size)
+        goto end;
+    if (entries[p] == ControlFlow::noBlock)
+        goto fallback;
+    slot = slots + entries[p];
+    DISPATCH();
+
+    // a target that doesn't start a block: one position at a time until one
+    // that does
+fallback:
+    {
+        const Instruction &instruction = code[p];
+        reg = r;
+        pos = p;
+        if (instruction.alt ? execute(instruction, stackB, stackA) : execute(instruction, stackA, stackB))
+            ++pos;
+        r = reg;
+        if (status != Status::Normal)
+            goto end;
+        if (pos != p + instruction.length){
+            JUMP(p, pos);
+        }
+        p = pos;
+    }
+    goto enter;
+
+fallThrough:
+    p = slot->position;
+    goto enter;
+
+    HANDLER(Digit)      r = r * 10 + slot->instruction->digit; NEXT();
+    HANDLER(Error)      p = slot->position;
+                        status = Status::Error;
+                        goto end;
+
+    HANDLER(None)       NEXT();
+
+    HANDLER(Add)        r = FIRST.top() + SECOND.top(); NEXT();
+    HANDLER(Mul)        r = FIRST.top() * SECOND.top(); NEXT();
+    HANDLER(Sub)        r = FIRST.top() - SECOND.top(); NEXT();
+    HANDLER(Pow)        DELEGATE();
+    HANDLER(Div)        if (SECOND.top() == 0){
+                            DELEGATE();
+                        }
+                        r = FIRST.top() / SECOND.top();
+                        NEXT();
+    HANDLER(Rem)        if (SECOND.top() == 0){
+                            DELEGATE();
+                        }
+                        r = FIRST.top() % SECOND.top();
+                        NEXT();
+
+    HANDLER(Zero)       r = 0; NEXT();
+
+    HANDLER(Equal)      r = FIRST.top() == SECOND.top(); NEXT();
+    HANDLER(Unequal)    r = FIRST.top() != SECOND.top(); NEXT();
+    HANDLER(BetweenI){  Number min = std::min(FIRST.top(), SECOND.top());
+                        Number max = std::max(FIRST.top(), SECOND.top());
+                        r = (min <= r) && (r <= max);
+                        } NEXT();
+    HANDLER(BetweenE){  Number min = std::min(FIRST.top(), SECOND.top());
+                        Number max = std::max(FIRST.top(), SECOND.top());
+                        r = (min < r) && (r < max);
+                        } NEXT();
+    HANDLER(Greater)    r = FIRST.top() > SECOND.top(); NEXT();
+    HANDLER(GreOrEq)    r = FIRST.top() >= SECOND.top(); NEXT();
+    HANDLER(Not)        r = !FIRST.top(); NEXT();
+    HANDLER(And)        r = Number(FIRST.top() && SECOND.top()); NEXT();
+    HANDLER(Or)         r = Number(FIRST.top() || SECOND.top()); NEXT();
+    HANDLER(Xor)        r = Number(!FIRST.top() != !SECOND.top()); NEXT();
+
+    HANDLER(Rand)       DELEGATE();
+    HANDLER(Min)        r = std::min(FIRST.top(), SECOND.top()); NEXT();
+    HANDLER(Max)        r = std::max(FIRST.top(), SECOND.top()); NEXT();
+
+    HANDLER(Push)       FIRST.push(r); NEXT();
+    HANDLER(PushS)      DELEGATE();
+    HANDLER(PushRS)     DELEGATE();
+    HANDLER(Send)       SECOND.push(FIRST.top());
+                        FIRST.pop();
+                        NEXT();
+    HANDLER(Peek)       r = FIRST.top(); NEXT();
+    HANDLER(Pop)        FIRST.pop();
+                        NEXT();
+    HANDLER(Swap)       std::swap(FIRST.top(), SECOND.top()); NEXT();
+
+    HANDLER(Save)       FIRST.push(slot->position + 1); NEXT();
+    HANDLER(Jump)       if (r){
+                            JUMP(slot->position, FIRST.top());
+                        }
+                        NEXT();
+    HANDLER(Reset)      DELEGATE();
+    HANDLER(Halt)       JUMP(slot->position, r ? Number(-1) : slot->position); // without r it never moves on
+
+    HANDLER(PrintN)     DELEGATE();
+    HANDLER(PrintC)     DELEGATE();
+    HANDLER(PrintS)     DELEGATE();
+    HANDLER(PrintSiN)   DELEGATE();
+    HANDLER(PrintSiC)   DELEGATE();
+    HANDLER(ReadN)      DELEGATE();
+    HANDLER(ReadC)      DELEGATE();
+
+    HANDLER(Digits)     r = r * powerOfTen(slot->instruction->digit) + constants[slot->instruction->constant]; NEXT();
+    HANDLER(Constant)   r = constants[slot->instruction->constant]; NEXT();
+    HANDLER(PushConst)  r = constants[slot->instruction->constant];
+                        FIRST.push(r);
+                        NEXT();
+    HANDLER(PeekPop)    r = FIRST.top();
+                        FIRST.pop();
+                        NEXT();
+
+end:
+    steps += p - segment;
+    if ((status == Status::Normal) && (p >= size))
+        status = Status::EoF;
+    reg = r;
+    pos = p;
+}
+
+#else
+
+void Interpreter::executeBlocks(){
+    executeThreaded();
+}
+
+#endif
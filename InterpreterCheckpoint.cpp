@@ -0,0 +1,114 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Interpreter.h"
+#include "Checkpoint.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Checkpoints are written by a child process (fork()), which sees the
+// stacks as they were thanks to copy-on-write while the program goes on
+// running. Only one is written at a time. Without fork() they are written
+// in place.
+bool Interpreter::checkpoint(const std::string &path){
+    if (!finishCheckpoint())
+        return false;
+
+    output.flush(); // the offset has to match what is already out
+
+    Checkpoint::State state;
+    state.program = Checkpoint::fingerprint(*loaded);
+    state.reg = reg;
+    state.pos = pos;
+    state.steps = steps;
+    state.output = output.written();
+    state.input = input.position();
+    std::string generator = random.serialize();
+    std::string temporary = path + ".tmp";
+    checkpointPath = path;
+
+#ifndef _WIN32
+    pid_t child = fork();
+    if (child == 0)
+        _exit(Checkpoint::write(path.c_str(), temporary.c_str(), state, generator, stackA, stackB) ? 0 : 1);
+    if (child > 0){
+        checkpointer = child;
+        return true;
+    }
+#endif
+
+    if (Checkpoint::write(path.c_str(), temporary.c_str(), state, generator, stackA, stackB))
+        return true;
+
+    report("The checkpoint could not be written (" + path + ")");
+    return false;
+}
+
+// waits for the checkpoint being written, if any
+bool Interpreter::finishCheckpoint(){
+#ifndef _WIN32
+    if (checkpointer == 0)
+        return true;
+
+    int result;
+    pid_t done;
+    do{
+        done = waitpid(checkpointer, &result, 0);
+    } while ((done < 0) && (errno == EINTR));
+    checkpointer = 0;
+
+    if ((done > 0) && WIFEXITED(result) && (WEXITSTATUS(result) == 0))
+        return true;
+
+    report("The checkpoint could not be written (" + checkpointPath + ")");
+    return false;
+#else
+    return true;
+#endif
+}
+
+// Call it after load() and before execute(). The input skips what the
+// checkpointed run had read, and the output is cut back to what it had
+// written (see OutputSink::resumeAt()).
+bool Interpreter::restore(const std::string &path){
+    Checkpoint checkpoint;
+    Checkpoint::State state;
+    std::string generator;
+    state.program = Checkpoint::fingerprint(*loaded);
+    if (!checkpoint.read(path, state, generator, stackA, stackB)){
+        report("The checkpoint could not be read (" + path + "): " + checkpoint.error());
+        return false;
+    }
+    if (!random.deserialize(generator)){
+        report("The checkpoint could not be read (" + path + "): its generator is damaged");
+        return false;
+    }
+
+    reg = state.reg;
+    pos = state.pos;
+    steps = state.steps;
+    status = Status::Normal;
+    output.resumeAt(state.output);
+    input.skip(state.input);
+    return true;
+}
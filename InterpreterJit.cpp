@@ -0,0 +1,80 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Interpreter.h"
+#include "Jit.h"
+
+// Runs the compiled code and interprets, one at a time, the instructions it
+// leaves to the interpreter. Without JIT support (or if the executable
+// memory can't be allocated) the threaded engine is used instead.
+void Interpreter::executeJit(){
+    if (!JitCode::supported()){
+        executeThreaded();
+        return;
+    }
+
+    // compiled once, then every slice of run() reuses it
+    if (!jitCode)
+        jitCode.reset(new JitCode(loaded->instructions));
+    const JitCode &code = *jitCode;
+    if (!code.valid()){
+        executeThreaded();
+        return;
+    }
+
+    JitState state;
+    state.stacks[0] = &stackA;
+    state.stacks[1] = &stackB;
+    state.top[0] = &stackA.top();
+    state.top[1] = &stackB.top();
+
+    while (status == Status::Normal){
+        state.reg = reg;
+        state.pos = pos;
+        state.steps = steps;
+        state.segment = pos;
+        state.nextCheck = nextCheck;
+
+        JitCode::Exit exit = code.run(state);
+        reg = state.reg;
+        pos = state.pos;
+        steps = state.steps + (state.pos - state.segment);
+
+        if (exit == JitCode::Exit::EoF){
+            status = Status::EoF;
+        } else if (exit == JitCode::Exit::Check){
+            checkLimits();
+        } else{
+            const Instruction &instruction = loaded->instructions[pos];
+            bool increment;
+            if (instruction.alt)
+                increment = execute(instruction, stackB, stackA);
+            else
+                increment = execute(instruction, stackA, stackB);
+
+            if (increment)
+                ++pos;
+            if (status == Status::Input)
+                break; // it runs again once there is input
+            ++steps;
+            if (steps >= nextCheck)
+                checkLimits();
+        }
+    }
+}
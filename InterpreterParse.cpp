@@ -0,0 +1,210 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Interpreter.h"
+
+#include <array>
+#include <cstring>
+#include <map>
+
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#include <emmintrin.h>
+#define DSTACK_SSE2
+#endif
+
+// Interpreter::parse(), written for large generated programs: every byte is
+// classified with one table lookup, blanks are skipped 16 bytes at a time,
+// and comments and string literals are skipped a line at a time with
+// memchr(). Lines and columns are counted from the start of the current line
+// instead of character by character.
+
+namespace {
+
+enum CharClass : unsigned char {Invalid, Code, Blank, Newline, Slash, At};
+
+constexpr std::array<unsigned char, 256> makeClasses(){
+    std::array<unsigned char, 256> classes{};
+    for (const char *ch = "dstackDSTACK0123456789"; *ch; ++ch)
+        classes[static_cast<unsigned char>(*ch)] = Code;
+    classes[' '] = Blank;
+    classes['\t'] = Blank;
+    classes['\r'] = Blank;
+    classes['\n'] = Newline;
+    classes['/'] = Slash;
+    classes['@'] = At;
+    return classes;
+}
+
+constexpr std::array<unsigned char, 256> classes = makeClasses();
+
+// Skips blanks and newlines, keeping line and lineStart up to date.
+const char *skipBlanks(const char *p, const char *end, std::string::size_type &line, const char *&lineStart){
+#ifdef DSTACK_SSE2
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+
+    while (end - p >= 16){
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i newlines = _mm_cmpeq_epi8(chunk, lf);
+        __m128i blanks = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, tab)),
+                                      _mm_or_si128(_mm_cmpeq_epi8(chunk, cr), newlines));
+
+        unsigned int others = ~_mm_movemask_epi8(blanks) & 0xffff;
+        unsigned int skipped = others ? __builtin_ctz(others) : 16;
+        unsigned int lines = _mm_movemask_epi8(newlines) & ((1u << skipped) - 1);
+        if (lines){
+            line += __builtin_popcount(lines);
+            lineStart = p + (31 - __builtin_clz(lines)) + 1;
+        }
+
+        p += skipped;
+        if (others)
+            return p;
+    }
+#endif
+
+    for (; p != end; ++p){
+        unsigned char kind = classes[static_cast<unsigned char>(*p)];
+        if (kind == Newline){
+            ++line;
+            lineStart = p + 1;
+        } else if (kind != Blank){
+            break;
+        }
+    }
+    return p;
+}
+
+}
+
+bool Interpreter::parse(Program &loading){
+    std::string &sourceParsed = loading.sourceParsed;
+    LineTable &lines = loading.lines;
+
+    const char *begin = source.data();
+    const char *end = begin + source.size();
+    const char *p = begin;
+    const char *lineStart = begin;
+    std::string::size_type line = 1;
+
+    auto column = [&](const char *at){
+        return std::string::size_type(at - lineStart) + 1;
+    };
+
+    auto invalid = [&](const char *at, const char *detail){
+        status = Status::Error;
+        errorInfo.position = {line, column(at)};
+        errorInfo.error = "Invalid character: ";
+        errorInfo.error += *at;
+        errorInfo.error += detail;
+    };
+
+    std::map<Number, std::string> literals;
+    sourceParsed.clear();
+    sourceParsed.reserve(source.size());
+    lines.clear();
+
+    while ((p != end) && (status != Status::Error)){
+        switch (classes[static_cast<unsigned char>(*p)]){
+            case Code:{
+                const char *run = p;
+                while ((++p != end) && (classes[static_cast<unsigned char>(*p)] == Code));
+                lines.add(sourceParsed.size(), p - run, line, column(run));
+                sourceParsed.append(run, p);
+                } break;
+
+            case Blank:
+            case Newline:
+                p = skipBlanks(p, end, line, lineStart);
+                break;
+
+            case Slash:{ // up to the end of the line, which is handled as code
+                const char *newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+                p = newline ? newline : end;
+                } break;
+
+            case At:{
+                if (p != lineStart){
+                    invalid(p, "");
+                    break;
+                }
+
+                // "@" alone starts a comment, "@id" a string literal
+                PositionInfo atPosition = {line, 1};
+                Number stringId = 0;
+                for (++p; (p != end) && (*p != '\n'); ++p){
+                    if (!isDigit(*p)){
+                        invalid(p, " (Only digits are allowed)");
+                        break;
+                    }
+                    stringId = stringId * 10 + (*p - '0');
+                }
+                if ((status == Status::Error) || (p == end))
+                    break;
+
+                bool comment = p == lineStart + 1;
+                std::string *literal = comment ? nullptr : &literals[stringId];
+                ++line;
+                lineStart = ++p;
+
+                // Line by line until one that is just "@". Any other line
+                // starting with '@' is part of the contents.
+                bool closed = false;
+                while (p != end){
+                    if ((*p == '@') && (p + 1 != end) && (p[1] == '\n')){
+                        if (literal && !literal->empty())
+                            literal->pop_back(); // the newline before the '@'
+                        ++p; // the newline is left for the code
+                        closed = true;
+                        break;
+                    }
+
+                    const char *newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+                    const char *next = newline ? newline + 1 : end;
+                    if (literal)
+                        literal->append(p, next);
+                    if (newline){
+                        ++line;
+                        lineStart = next;
+                    }
+                    p = next;
+                }
+
+                if (!closed){
+                    status = Status::Error;
+                    errorInfo.position = atPosition;
+                    errorInfo.error = comment ? "The comment is not closed before the end of file. Start"
+                                              : "The string literal is not closed before the end of file. Start";
+                }
+                } break;
+
+            default:
+                invalid(p, "");
+                break;
+        }
+    }
+
+    loading.strings = StringTable(literals);
+    sourceParsed.shrink_to_fit();
+    lines.shrink();
+
+    return status != Status::Error;
+}
@@ -0,0 +1,194 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#include "Interpreter.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <ostream>
+
+// --profile: how many times every position ran, where the taken jumps went
+// and how deep the stacks got. The counters are flat arrays indexed by
+// position; everything else (opcodes, line:col) is worked out when the
+// report is written.
+
+namespace {
+
+const std::size_t reportedRows = 20;
+
+double percent(Number count, Number total){
+    return total ? (100.0 * count / total) : 0.0;
+}
+
+}
+
+// call it after load()
+void Interpreter::enableProfile(){
+    profile.reset(new Profile());
+    profile->counts.assign(loaded->instructions.size(), 0);
+    profile->jumps.resize(loaded->instructions.size());
+    profile->highWater[0] = stackA.size();
+    profile->highWater[1] = stackB.size();
+}
+
+void Interpreter::profileStep(Number position, const Instruction &instruction, bool jumped){
+    ++profile->counts[position];
+
+    switch (instruction.code){
+        case Opcodes::Jump:
+            if (jumped){
+                std::vector<Profile::Edge> &edges = profile->jumps[position];
+                auto edge = std::find_if(edges.begin(), edges.end(), [this](const Profile::Edge &e){
+                    return e.target == pos;
+                });
+                if (edge != edges.end())
+                    ++edge->count;
+                else
+                    edges.push_back({pos, 1});
+            }
+            break;
+
+        // the only ones that make a stack deeper
+        case Opcodes::Push:
+        case Opcodes::PushS:
+        case Opcodes::PushRS:
+        case Opcodes::Send:
+        case Opcodes::Save:
+            profile->highWater[0] = std::max(profile->highWater[0], stackA.size());
+            profile->highWater[1] = std::max(profile->highWater[1], stackB.size());
+            break;
+
+        default:
+            break;
+    }
+}
+
+void Interpreter::writeProfile(std::ostream &report, std::ostream &json) const{
+    if (!profile)
+        return;
+
+    const std::string &sourceParsed = loaded->sourceParsed;
+    const InstructionView instructions = loaded->instructions;
+
+    struct Row{
+        Number position;
+        Number count;
+    };
+
+    struct Jump{
+        Number from;
+        Number to;
+        Number count;
+    };
+
+    auto location = [this, &sourceParsed](Number position){
+        if (position >= sourceParsed.size())
+            return std::string("end");
+        PositionInfo info = positionOf(position);
+        return std::to_string(info.line) + ":" + std::to_string(info.col);
+    };
+
+    Number total = 0;
+    std::map<Opcodes, Number> byOpcode;
+    std::vector<Row> positions;
+    for (Number i = 0; i < profile->counts.size(); ++i){
+        Number count = profile->counts[i];
+        if (count == 0)
+            continue;
+        total += count;
+        byOpcode[instructions[i].code] += count;
+        positions.push_back({i, count});
+    }
+
+    std::vector<std::pair<Opcodes, Number>> opcodes(byOpcode.begin(), byOpcode.end());
+
+    std::vector<Jump> jumps;
+    for (Number i = 0; i < profile->jumps.size(); ++i)
+        for (const Profile::Edge &edge : profile->jumps[i])
+            jumps.push_back({i, edge.target, edge.count});
+
+    auto byCount = [](const Row &a, const Row &b){
+        return (a.count != b.count) ? (a.count > b.count) : (a.position < b.position);
+    };
+    std::stable_sort(opcodes.begin(), opcodes.end(), [](const std::pair<Opcodes, Number> &a,
+                                                        const std::pair<Opcodes, Number> &b){
+        return a.second > b.second;
+    });
+    std::sort(positions.begin(), positions.end(), byCount);
+    std::sort(jumps.begin(), jumps.end(), [](const Jump &a, const Jump &b){
+        return (a.count != b.count) ? (a.count > b.count) : (a.from < b.from);
+    });
+
+    report << std::fixed << std::setprecision(2);
+    report << "profile: " << total << " instructions executed\n\n";
+
+    report << "by opcode\n";
+    for (const auto &opcode : opcodes){
+        report << std::setw(14) << opcode.second << std::setw(8) << percent(opcode.second, total) << "%  ";
+        report << toString(opcode.first) << "\n";
+    }
+
+    report << "\nhottest positions\n";
+    for (std::size_t i = 0; (i < positions.size()) && (i < reportedRows); ++i){
+        const Row &row = positions[i];
+        report << std::setw(14) << row.count << std::setw(8) << percent(row.count, total) << "%  ";
+        report << std::setw(9) << std::left << location(row.position) << std::right;
+        report << " (" << sourceParsed[row.position] << sourceParsed[row.position + 1] << ") ";
+        report << toString(instructions[row.position].code) << "\n";
+    }
+
+    report << "\nhottest jumps\n";
+    for (std::size_t i = 0; (i < jumps.size()) && (i < reportedRows); ++i){
+        const Jump &jump = jumps[i];
+        report << std::setw(14) << jump.count << "  " << location(jump.from) << " -> " << location(jump.to) << "\n";
+    }
+
+    report << "\nstack high-water marks: " << profile->highWater[0] << " (first), ";
+    report << profile->highWater[1] << " (second)\n";
+
+    json << "{\n";
+    json << "  \"instructions\": " << total << ",\n";
+    json << "  \"highWater\": [" << profile->highWater[0] << ", " << profile->highWater[1] << "],\n";
+
+    json << "  \"opcodes\": [";
+    for (std::size_t i = 0; i < opcodes.size(); ++i){
+        json << (i ? ",\n" : "\n") << "    {\"opcode\": \"" << toString(opcodes[i].first);
+        json << "\", \"count\": " << opcodes[i].second << "}";
+    }
+    json << "\n  ],\n";
+
+    json << "  \"positions\": [";
+    for (std::size_t i = 0; i < positions.size(); ++i){
+        const Row &row = positions[i];
+        PositionInfo info = positionOf(row.position);
+        json << (i ? ",\n" : "\n") << "    {\"position\": " << row.position;
+        json << ", \"line\": " << info.line << ", \"col\": " << info.col;
+        json << ", \"opcode\": \"" << toString(instructions[row.position].code);
+        json << "\", \"count\": " << row.count << "}";
+    }
+    json << "\n  ],\n";
+
+    json << "  \"jumps\": [";
+    for (std::size_t i = 0; i < jumps.size(); ++i){
+        json << (i ? ",\n" : "\n") << "    {\"from\": " << jumps[i].from << ", \"to\": " << jumps[i].to;
+        json << ", \"count\": " << jumps[i].count << "}";
+    }
+    json << "\n  ]\n";
+    json << "}\n";
+}
@@ -0,0 +1,226 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Interpreter.h"
+#include "Fusion.h"
+
+#include <algorithm>
+#include <vector>
+
+// Direct-threaded version of Interpreter::executeSwitch(). With GCC and Clang
+// every position gets the address of its handler and each handler jumps
+// straight to the next one (computed goto). Other compilers get a single
+// switch inside the loop, which still avoids a call per instruction.
+//
+// It runs the fused program (see Fusion.h), so an instruction can cover
+// several positions.
+//
+// The simple instructions are handled inline; the ones that are dominated by
+// their own work (strings, I/O, random numbers, Reset) go through the same
+// Interpreter::execute() used by the switch engine, so both engines behave
+// exactly the same.
+
+#if defined(__GNUC__) || defined(__clang__)
+#define DSTACK_COMPUTED_GOTO
+#endif
+
+#define DSTACK_OPCODES(X) \
+    X(Digit) X(Error) X(None) \
+    X(Add) X(Mul) X(Sub) X(Pow) X(Div) X(Rem) \
+    X(Zero) \
+    X(Equal) X(Unequal) X(BetweenI) X(BetweenE) X(Greater) X(GreOrEq) \
+    X(Not) X(And) X(Or) X(Xor) \
+    X(Rand) X(Min) X(Max) \
+    X(Push) X(PushS) X(PushRS) X(Send) X(Peek) X(Pop) X(Swap) \
+    X(Save) X(Jump) X(Reset) X(Halt) \
+    X(PrintN) X(PrintC) X(PrintS) X(PrintSiN) X(PrintSiC) X(ReadN) X(ReadC) \
+    X(Digits) X(Constant) X(PushConst) X(PeekPop)
+
+#ifdef DSTACK_COMPUTED_GOTO
+    #define HANDLER(op) op_##op:
+    #define DISPATCH() \
+        if (p >= size) \
+            goto end; \
+        instruction = &code[p]; \
+        first = stacks[instruction->alt]; \
+        second = stacks[!instruction->alt]; \
+        goto *table[p]
+#else
+    #define HANDLER(op) case Opcodes::op:
+    #define DISPATCH() continue
+#endif
+
+#define NEXT() p += instruction->length; DISPATCH()
+
+// Instructions are counted at jumps: everything from the last jump target up
+// to the jump itself ran once. The limits are checked there too.
+#define JUMP(target) \
+    steps += p + 1 - segment; \
+    p = segment = (target); \
+    if (steps >= nextCheck){ \
+        reg = r; \
+        pos = p; \
+        if (!checkLimits()) \
+            goto end; \
+    } \
+    DISPATCH()
+
+// hands the instruction to the switch engine
+#define DELEGATE() \
+    reg = r; \
+    pos = p; \
+    if (execute(*instruction, *first, *second)) \
+        ++pos; \
+    r = reg; \
+    if (status != Status::Normal) \
+        goto end; \
+    JUMP(pos)
+
+void Interpreter::executeThreaded(){
+    Stack *stacks[2] = {&stackA, &stackB};
+    const Instruction *code = loaded->fused.data();
+    const Number *constants = loaded->constants.data();
+    const Number size = loaded->fused.size();
+
+    // local copies, so the compiler can keep them in registers
+    Number r = reg;
+    Number p = pos;
+    Number segment = p;
+
+    const Instruction *instruction;
+    Stack *first;
+    Stack *second;
+
+#ifdef DSTACK_COMPUTED_GOTO
+    // the same for every call, as long as the program doesn't change
+    if (handlers.size() != size){
+        handlers.resize(size);
+        for (Number i = 0; i < size; ++i){
+            switch (code[i].code){
+                #define LABEL(op) case Opcodes::op: handlers[i] = &&op_##op; break;
+                DSTACK_OPCODES(LABEL)
+                #undef LABEL
+            }
+        }
+    }
+    void *const *table = handlers.data();
+
+    DISPATCH();
+#else
+    for (;;){
+    if (p >= size)
+        goto end;
+    instruction = &code[p];
+    first = stacks[instruction->alt];
+    second = stacks[!instruction->alt];
+
+    switch (instruction->code){
+#endif
+
+    HANDLER(Digit)      r = r * 10 + instruction->digit; NEXT();
+    HANDLER(Error)      status = Status::Error; goto end;
+
+    HANDLER(None)       NEXT();
+
+    HANDLER(Add)        r = first->top() + second->top(); NEXT();
+    HANDLER(Mul)        r = first->top() * second->top(); NEXT();
+    HANDLER(Sub)        r = first->top() - second->top(); NEXT();
+    HANDLER(Pow)        DELEGATE();
+    HANDLER(Div)        if (second->top() == 0){
+                            DELEGATE();
+                        }
+                        r = first->top() / second->top();
+                        NEXT();
+    HANDLER(Rem)        if (second->top() == 0){
+                            DELEGATE();
+                        }
+                        r = first->top() % second->top();
+                        NEXT();
+
+    HANDLER(Zero)       r = 0; NEXT();
+
+    HANDLER(Equal)      r = first->top() == second->top(); NEXT();
+    HANDLER(Unequal)    r = first->top() != second->top(); NEXT();
+    HANDLER(BetweenI){  Number min = std::min(first->top(), second->top());
+                        Number max = std::max(first->top(), second->top());
+                        r = (min <= r) && (r <= max);
+                        } NEXT();
+    HANDLER(BetweenE){  Number min = std::min(first->top(), second->top());
+                        Number max = std::max(first->top(), second->top());
+                        r = (min < r) && (r < max);
+                        } NEXT();
+    HANDLER(Greater)    r = first->top() > second->top(); NEXT();
+    HANDLER(GreOrEq)    r = first->top() >= second->top(); NEXT();
+    HANDLER(Not)        r = !first->top(); NEXT();
+    HANDLER(And)        r = Number(first->top() && second->top()); NEXT();
+    HANDLER(Or)         r = Number(first->top() || second->top()); NEXT();
+    HANDLER(Xor)        r = Number(!first->top() != !second->top()); NEXT();
+
+    HANDLER(Rand)       DELEGATE();
+    HANDLER(Min)        r = std::min(first->top(), second->top()); NEXT();
+    HANDLER(Max)        r = std::max(first->top(), second->top()); NEXT();
+
+    HANDLER(Push)       first->push(r); NEXT();
+    HANDLER(PushS)      DELEGATE();
+    HANDLER(PushRS)     DELEGATE();
+    HANDLER(Send)       second->push(first->top());
+                        first->pop();
+                        NEXT();
+    HANDLER(Peek)       r = first->top(); NEXT();
+    HANDLER(Pop)        first->pop();
+                        NEXT();
+    HANDLER(Swap)       std::swap(first->top(), second->top()); NEXT();
+
+    HANDLER(Save)       first->push(p + 1); NEXT();
+    HANDLER(Jump)       if (r){
+                            JUMP(first->top());
+                        }
+                        NEXT();
+    HANDLER(Reset)      DELEGATE();
+    HANDLER(Halt)       JUMP(r ? Number(-1) : p); // without r it never moves on
+
+    HANDLER(PrintN)     DELEGATE();
+    HANDLER(PrintC)     DELEGATE();
+    HANDLER(PrintS)     DELEGATE();
+    HANDLER(PrintSiN)   DELEGATE();
+    HANDLER(PrintSiC)   DELEGATE();
+    HANDLER(ReadN)      DELEGATE();
+    HANDLER(ReadC)      DELEGATE();
+
+    HANDLER(Digits)     r = r * powerOfTen(instruction->digit) + constants[instruction->constant]; NEXT();
+    HANDLER(Constant)   r = constants[instruction->constant]; NEXT();
+    HANDLER(PushConst)  r = constants[instruction->constant];
+                        first->push(r);
+                        NEXT();
+    HANDLER(PeekPop)    r = first->top();
+                        first->pop();
+                        NEXT();
+
+#ifndef DSTACK_COMPUTED_GOTO
+    }
+    }
+#endif
+
+end:
+    steps += p - segment;
+    if ((status == Status::Normal) && (p >= size))
+        status = Status::EoF;
+    reg = r;
+    pos = p;
+}
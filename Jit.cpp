@@ -0,0 +1,641 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Jit.h"
+
+#include <cstddef>
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__unix__))
+#define DSTACK_JIT
+#include <sys/mman.h>
+#endif
+
+#ifdef DSTACK_JIT
+
+// where the fields of a Stack are, from the address of its top value
+struct StackLayout{
+    static const std::int8_t value = 0;
+    static const std::int8_t below = offsetof(Stack, below) - offsetof(Stack, value);
+    static const std::int8_t base = offsetof(Stack, base) - offsetof(Stack, value);
+    static const std::int8_t limit = offsetof(Stack, limit) - offsetof(Stack, value);
+};
+
+namespace {
+
+enum Register {
+    RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+    R8 = 8, R9 = 9, R10 = 10, R11 = 11, R12 = 12, R13 = 13, R14 = 14, R15 = 15
+};
+
+enum Condition {
+    Below = 0x2, AboveOrEqual = 0x3, Equal = 0x4, NotEqual = 0x5,
+    BelowOrEqual = 0x6, Above = 0x7
+};
+
+// register allocation of the generated code
+const Register regRegister = RBX;
+const Register stateRegister = R12;
+const Register topRegisters[2] = {R13, R14};
+const Register tableRegister = R15;
+
+const std::int8_t regOffset = offsetof(JitState, reg);
+const std::int8_t posOffset = offsetof(JitState, pos);
+const std::int8_t stepsOffset = offsetof(JitState, steps);
+const std::int8_t segmentOffset = offsetof(JitState, segment);
+const std::int8_t nextCheckOffset = offsetof(JitState, nextCheck);
+const std::int8_t topOffsets[2] = {offsetof(JitState, top), offsetof(JitState, top) + sizeof(Number*)};
+
+// the few x86-64 instructions the compiler needs, always 64 bits wide
+class Assembler{
+public:
+    std::vector<std::uint8_t> code;
+
+    std::size_t size() const{
+        return code.size();
+    }
+
+    void byte(std::uint8_t b){
+        code.push_back(b);
+    }
+
+    void imm32(std::uint32_t value){
+        for (int i = 0; i < 4; ++i)
+            byte(static_cast<std::uint8_t>(value >> (i * 8)));
+    }
+
+    void imm64(std::uint64_t value){
+        for (int i = 0; i < 8; ++i)
+            byte(static_cast<std::uint8_t>(value >> (i * 8)));
+    }
+
+    void patch32(std::size_t at, std::uint32_t value){
+        for (int i = 0; i < 4; ++i)
+            code[at + i] = static_cast<std::uint8_t>(value >> (i * 8));
+    }
+
+    // op reg, rm (both registers)
+    void regReg(std::uint8_t opcode, Register reg, Register rm){
+        rex(reg, rm);
+        byte(opcode);
+        byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+    }
+
+    // two byte opcodes (0F xx) with register operands
+    void regReg0F(std::uint8_t opcode, Register reg, Register rm){
+        rex(reg, rm);
+        byte(0x0F);
+        byte(opcode);
+        byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+    }
+
+    // op reg, [base + disp]
+    void regMem(std::uint8_t opcode, Register reg, Register base, std::int8_t disp){
+        rex(reg, base);
+        byte(opcode);
+        byte(0x40 | ((reg & 7) << 3) | (base & 7));
+        if ((base & 7) == RSP)
+            byte(0x24);
+        byte(static_cast<std::uint8_t>(disp));
+    }
+
+    void load(Register reg, Register base, std::int8_t disp = 0){
+        regMem(0x8B, reg, base, disp);
+    }
+
+    void store(Register base, std::int8_t disp, Register reg){
+        regMem(0x89, reg, base, disp);
+    }
+
+    void mov(Register to, Register from){
+        regReg(0x8B, to, from);
+    }
+
+    void movImm(Register reg, std::uint64_t value){
+        byte(0x48 | ((reg & 8) >> 3));
+        byte(0xB8 | (reg & 7));
+        imm64(value);
+    }
+
+    void add(Register to, Register from){
+        regReg(0x03, to, from);
+    }
+
+    void sub(Register to, Register from){
+        regReg(0x2B, to, from);
+    }
+
+    void imul(Register to, Register from){
+        regReg0F(0xAF, to, from);
+    }
+
+    void imulImm(Register reg, std::int8_t value){
+        regReg(0x6B, reg, reg);
+        byte(static_cast<std::uint8_t>(value));
+    }
+
+    void addImm(Register reg, std::int8_t value){
+        regReg(0x83, RAX, reg); // /0
+        byte(static_cast<std::uint8_t>(value));
+    }
+
+    void orr(Register to, Register from){
+        regReg(0x0B, to, from);
+    }
+
+    void cmp(Register a, Register b){
+        regReg(0x3B, a, b);
+    }
+
+    void test(Register a, Register b){
+        regReg(0x85, b, a);
+    }
+
+    void cmov(Condition condition, Register to, Register from){
+        regReg0F(0x40 | condition, to, from);
+    }
+
+    // unsigned rdx:rax / reg
+    void div(Register reg){
+        byte(0x48 | ((reg & 8) >> 3));
+        byte(0xF7);
+        byte(0xF0 | (reg & 7));
+    }
+
+    // 32 bit xor, clears the whole 64 bit register
+    void clear(Register reg){
+        if (reg & 8)
+            byte(0x45);
+        byte(0x31);
+        byte(0xC0 | ((reg & 7) << 3) | (reg & 7));
+    }
+
+    // al or cl only
+    void set(Condition condition, Register reg){
+        byte(0x0F);
+        byte(0x90 | condition);
+        byte(0xC0 | reg);
+    }
+
+    void andByte(Register to, Register from){
+        byte(0x22);
+        byte(0xC0 | (to << 3) | from);
+    }
+
+    void xorByte(Register to, Register from){
+        byte(0x32);
+        byte(0xC0 | (to << 3) | from);
+    }
+
+    // movzx ebx, al
+    void zeroExtendToReg(){
+        byte(0x0F);
+        byte(0xB6);
+        byte(0xC0 | (RBX << 3) | RAX);
+    }
+
+    void push(Register reg){
+        if (reg & 8)
+            byte(0x41);
+        byte(0x50 | (reg & 7));
+    }
+
+    void pop(Register reg){
+        if (reg & 8)
+            byte(0x41);
+        byte(0x58 | (reg & 7));
+    }
+
+    void callRax(){
+        byte(0xFF);
+        byte(0xD0);
+    }
+
+    void jmpReg(Register reg){
+        if (reg & 8)
+            byte(0x41);
+        byte(0xFF);
+        byte(0xE0 | (reg & 7));
+    }
+
+    // jmp [table + rax * 8]
+    void jmpTable(){
+        byte(0x41);
+        byte(0xFF);
+        byte(0x24);
+        byte(0xC0 | (RAX << 3) | (tableRegister & 7));
+    }
+
+    void ret(){
+        byte(0xC3);
+    }
+
+    // both return the offset of the rel32 operand
+    std::size_t jmp(){
+        byte(0xE9);
+        imm32(0);
+        return size() - 4;
+    }
+
+    std::size_t jcc(Condition condition){
+        byte(0x0F);
+        byte(0x80 | condition);
+        imm32(0);
+        return size() - 4;
+    }
+
+private:
+    void rex(Register reg, Register rm){
+        byte(0x48 | ((reg & 8) >> 1) | ((rm & 8) >> 3));
+    }
+};
+
+void jitPush(JitState *state, Number index, Number value){
+    state->stacks[index]->push(value);
+}
+
+class Compiler{
+public:
+    explicit Compiler(InstructionView instructions):
+    instructions(instructions),
+    positions   (instructions.size() + 1){
+    }
+
+    Assembler &compile(){
+        prologue();
+
+        for (std::size_t i = 0; i < instructions.size(); ++i){
+            positions[i] = a.size();
+            compile(i, instructions[i]);
+        }
+
+        // falling off the end of the program
+        positions[instructions.size()] = a.size();
+        a.movImm(RAX, instructions.size());
+        fixups.push_back({a.jmp(), Target::EoF});
+
+        eofLabel = a.size();
+        a.store(stateRegister, posOffset, RAX);
+        a.clear(RAX);
+        epilogueLabel = a.size();
+        a.store(stateRegister, regOffset, regRegister);
+        a.pop(R15);
+        a.pop(R14);
+        a.pop(R13);
+        a.pop(R12);
+        a.pop(RBX);
+        a.ret();
+
+        for (const Fixup &fixup : fixups){
+            std::size_t target = (fixup.target == Target::EoF) ? eofLabel : epilogueLabel;
+            a.patch32(fixup.at, static_cast<std::uint32_t>(target - (fixup.at + 4)));
+        }
+
+        return a;
+    }
+
+    const std::vector<std::size_t> &getPositions() const{
+        return positions;
+    }
+
+private:
+    enum class Target {EoF, Epilogue};
+
+    struct Fixup{
+        std::size_t at;
+        Target target;
+    };
+
+    // called as int (JitState *state, const void *entry, const void **table)
+    void prologue(){
+        a.push(RBX);
+        a.push(R12);
+        a.push(R13);
+        a.push(R14);
+        a.push(R15);
+        a.mov(stateRegister, RDI);
+        a.mov(tableRegister, RDX);
+        a.load(regRegister, stateRegister, regOffset);
+        a.load(topRegisters[0], stateRegister, topOffsets[0]);
+        a.load(topRegisters[1], stateRegister, topOffsets[1]);
+        a.jmpReg(RSI);
+    }
+
+    // leaves the generated code so the interpreter runs this position
+    void interpret(std::size_t position){
+        a.movImm(RAX, position);
+        a.store(stateRegister, posOffset, RAX);
+        a.byte(0xB8); // mov eax, Exit::Interpret
+        a.imm32(static_cast<std::uint32_t>(JitCode::Exit::Interpret));
+        fixups.push_back({a.jmp(), Target::Epilogue});
+    }
+
+    // Before a jump to rax: everything since the last jump target ran once.
+    // Once in a while the interpreter gets to check the limits.
+    void count(std::size_t position){
+        a.movImm(RCX, position + 1);
+        a.load(RDX, stateRegister, segmentOffset);
+        a.sub(RCX, RDX);
+        a.load(RDX, stateRegister, stepsOffset);
+        a.add(RDX, RCX);
+        a.store(stateRegister, stepsOffset, RDX);
+        a.store(stateRegister, segmentOffset, RAX);
+        a.load(RCX, stateRegister, nextCheckOffset);
+        a.cmp(RDX, RCX);
+        std::size_t skip = a.jcc(Below);
+        a.store(stateRegister, posOffset, RAX);
+        a.byte(0xB8); // mov eax, Exit::Check
+        a.imm32(static_cast<std::uint32_t>(JitCode::Exit::Check));
+        fixups.push_back({a.jmp(), Target::Epilogue});
+        a.patch32(skip, static_cast<std::uint32_t>(a.size() - (skip + 4)));
+    }
+
+    // rdi = state, rsi = stack index, rdx = argument
+    void call(void *function, Number index){
+        a.mov(RDI, stateRegister);
+        a.movImm(RSI, index);
+        a.movImm(RAX, reinterpret_cast<std::uint64_t>(function));
+        a.callRax(); // the tops stay where they are
+    }
+
+    // Stack::push(), with the value in rdx; only a full buffer calls out
+    void push(Register stack, Number index){
+        a.load(RAX, stack, StackLayout::below);
+        a.addImm(RAX, sizeof(Number));
+        a.load(RCX, stack, StackLayout::limit);
+        a.cmp(RAX, RCX);
+        std::size_t full = a.jcc(Equal);
+        a.load(RCX, stack, StackLayout::value);
+        a.store(RAX, 0, RCX);
+        a.store(stack, StackLayout::below, RAX);
+        a.store(stack, StackLayout::value, RDX);
+        std::size_t done = a.jmp();
+        a.patch32(full, static_cast<std::uint32_t>(a.size() - (full + 4)));
+        call(reinterpret_cast<void*>(&jitPush), index);
+        a.patch32(done, static_cast<std::uint32_t>(a.size() - (done + 4)));
+    }
+
+    // Stack::pop()
+    void pop(Register stack){
+        a.load(RAX, stack, StackLayout::below);
+        a.load(RCX, RAX);
+        a.store(stack, StackLayout::value, RCX);
+        a.mov(RCX, RAX);
+        a.addImm(RCX, -static_cast<std::int8_t>(sizeof(Number)));
+        a.load(RDX, stack, StackLayout::base);
+        a.cmp(RAX, RDX);
+        a.cmov(NotEqual, RAX, RCX);
+        a.store(stack, StackLayout::below, RAX);
+    }
+
+    void loadOperands(Register first, Register second){
+        a.load(RAX, first);
+        a.load(RCX, second);
+    }
+
+    void compare(Condition condition, Register first, Register second){
+        loadOperands(first, second);
+        a.cmp(RAX, RCX);
+        a.set(condition, RAX);
+        a.zeroExtendToReg();
+    }
+
+    void between(bool inclusive, Register first, Register second){
+        loadOperands(first, second);
+        // rdx = min, rsi = max
+        a.mov(RDX, RAX);
+        a.cmp(RDX, RCX);
+        a.cmov(Above, RDX, RCX);
+        a.mov(RSI, RAX);
+        a.cmp(RSI, RCX);
+        a.cmov(Below, RSI, RCX);
+        a.cmp(regRegister, RDX);
+        a.set(inclusive ? AboveOrEqual : Above, RAX);
+        a.cmp(regRegister, RSI);
+        a.set(inclusive ? BelowOrEqual : Below, RCX);
+        a.andByte(RAX, RCX);
+        a.zeroExtendToReg();
+    }
+
+    void division(bool remainder, std::size_t position, Register first, Register second){
+        loadOperands(first, second);
+        a.test(RCX, RCX);
+        std::size_t skip = a.jcc(NotEqual);
+        interpret(position);
+        a.patch32(skip, static_cast<std::uint32_t>(a.size() - (skip + 4)));
+        a.clear(RDX);
+        a.div(RCX);
+        a.mov(regRegister, remainder ? RDX : RAX);
+    }
+
+    void compile(std::size_t position, const Instruction &instruction){
+        Register first = topRegisters[instruction.alt];
+        Register second = topRegisters[!instruction.alt];
+        Number firstIndex = instruction.alt;
+
+        switch (instruction.code){
+            case Opcodes::Digit:    a.imulImm(regRegister, 10);
+                                    a.addImm(regRegister, instruction.digit);
+                                    break;
+
+            case Opcodes::None:     break;
+
+            case Opcodes::Add:      loadOperands(first, second);
+                                    a.add(RAX, RCX);
+                                    a.mov(regRegister, RAX);
+                                    break;
+            case Opcodes::Mul:      loadOperands(first, second);
+                                    a.imul(RAX, RCX);
+                                    a.mov(regRegister, RAX);
+                                    break;
+            case Opcodes::Sub:      loadOperands(first, second);
+                                    a.sub(RAX, RCX);
+                                    a.mov(regRegister, RAX);
+                                    break;
+            case Opcodes::Div:      division(false, position, first, second); break;
+            case Opcodes::Rem:      division(true, position, first, second); break;
+
+            case Opcodes::Zero:     a.clear(regRegister); break;
+
+            case Opcodes::Equal:    compare(Equal, first, second); break;
+            case Opcodes::Unequal:  compare(NotEqual, first, second); break;
+            case Opcodes::BetweenI: between(true, first, second); break;
+            case Opcodes::BetweenE: between(false, first, second); break;
+            case Opcodes::Greater:  compare(Above, first, second); break;
+            case Opcodes::GreOrEq:  compare(AboveOrEqual, first, second); break;
+            case Opcodes::Not:      a.load(RAX, first);
+                                    a.test(RAX, RAX);
+                                    a.set(Equal, RAX);
+                                    a.zeroExtendToReg();
+                                    break;
+            case Opcodes::And:      loadOperands(first, second);
+                                    a.test(RAX, RAX);
+                                    a.set(NotEqual, RAX);
+                                    a.test(RCX, RCX);
+                                    a.set(NotEqual, RCX);
+                                    a.andByte(RAX, RCX);
+                                    a.zeroExtendToReg();
+                                    break;
+            case Opcodes::Or:       loadOperands(first, second);
+                                    a.orr(RAX, RCX);
+                                    a.set(NotEqual, RAX);
+                                    a.zeroExtendToReg();
+                                    break;
+            case Opcodes::Xor:      loadOperands(first, second);
+                                    a.test(RAX, RAX);
+                                    a.set(NotEqual, RAX);
+                                    a.test(RCX, RCX);
+                                    a.set(NotEqual, RCX);
+                                    a.xorByte(RAX, RCX);
+                                    a.zeroExtendToReg();
+                                    break;
+
+            case Opcodes::Min:      loadOperands(first, second);
+                                    a.mov(regRegister, RAX);
+                                    a.cmp(regRegister, RCX);
+                                    a.cmov(Above, regRegister, RCX);
+                                    break;
+            case Opcodes::Max:      loadOperands(first, second);
+                                    a.mov(regRegister, RAX);
+                                    a.cmp(regRegister, RCX);
+                                    a.cmov(Below, regRegister, RCX);
+                                    break;
+
+            case Opcodes::Push:     a.mov(RDX, regRegister);
+                                    push(first, firstIndex);
+                                    break;
+            case Opcodes::Send:     a.load(RDX, first);
+                                    push(second, !firstIndex);
+                                    pop(first);
+                                    break;
+            case Opcodes::Peek:     a.load(regRegister, first); break;
+            case Opcodes::Pop:      pop(first); break;
+            case Opcodes::Swap:     loadOperands(first, second);
+                                    a.store(first, 0, RCX);
+                                    a.store(second, 0, RAX);
+                                    break;
+
+            case Opcodes::Save:     a.movImm(RDX, position + 1);
+                                    push(first, firstIndex);
+                                    break;
+            case Opcodes::Jump:{    a.test(regRegister, regRegister);
+                                    std::size_t skip = a.jcc(Equal);
+                                    a.load(RAX, first);
+                                    count(position);
+                                    a.movImm(RCX, instructions.size());
+                                    a.cmp(RAX, RCX);
+                                    fixups.push_back({a.jcc(AboveOrEqual), Target::EoF});
+                                    a.jmpTable();
+                                    a.patch32(skip, static_cast<std::uint32_t>(a.size() - (skip + 4)));
+                                    } break;
+            case Opcodes::Halt:{    a.test(regRegister, regRegister);
+                                    std::size_t skip = a.jcc(NotEqual);
+                                    interpret(position);
+                                    a.patch32(skip, static_cast<std::uint32_t>(a.size() - (skip + 4)));
+                                    a.movImm(RAX, static_cast<std::uint64_t>(-1));
+                                    count(position);
+                                    fixups.push_back({a.jmp(), Target::EoF});
+                                    } break;
+
+            default:                interpret(position); break;
+        }
+    }
+
+    InstructionView instructions;
+    std::vector<std::size_t> positions;
+    std::vector<Fixup> fixups;
+    std::size_t eofLabel;
+    std::size_t epilogueLabel;
+    Assembler a;
+};
+
+typedef int (*EntryFunction)(JitState *state, const void *entry, const void *const *table);
+
+}
+
+bool JitCode::supported(){
+    return true;
+}
+
+JitCode::JitCode(InstructionView instructions):
+code    (nullptr),
+codeSize(0){
+    Compiler compiler(instructions);
+    const Assembler &assembler = compiler.compile();
+
+    void *memory = mmap(nullptr, assembler.size(), PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        return;
+
+    std::memcpy(memory, assembler.code.data(), assembler.size());
+    if (mprotect(memory, assembler.size(), PROT_READ | PROT_EXEC) != 0){
+        munmap(memory, assembler.size());
+        return;
+    }
+
+    code = static_cast<std::uint8_t*>(memory);
+    codeSize = assembler.size();
+
+    entries.reserve(instructions.size());
+    for (std::size_t i = 0; i < instructions.size(); ++i)
+        entries.push_back(code + compiler.getPositions()[i]);
+}
+
+JitCode::~JitCode(){
+    if (code)
+        munmap(code, codeSize);
+}
+
+bool JitCode::valid() const{
+    return code != nullptr;
+}
+
+JitCode::Exit JitCode::run(JitState &state) const{
+    if (state.pos >= entries.size())
+        return Exit::EoF;
+
+    // the generated function starts at the beginning of the buffer
+    EntryFunction function = reinterpret_cast<EntryFunction>(code);
+    return static_cast<Exit>(function(&state, entries[state.pos], entries.data()));
+}
+
+#else
+
+bool JitCode::supported(){
+    return false;
+}
+
+JitCode::JitCode(InstructionView):
+code    (nullptr),
+codeSize(0){
+}
+
+JitCode::~JitCode(){
+}
+
+bool JitCode::valid() const{
+    return false;
+}
+
+JitCode::Exit JitCode::run(JitState&) const{
+    return Exit::Interpret;
+}
+
+#endif
@@ -0,0 +1,67 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "Interpreter.h"
+
+#include <cstdint>
+#include <vector>
+
+// Everything the generated code reads and writes, at fixed offsets.
+// While running, reg lives in rbx and the top pointers in r13 and r14.
+struct JitState{
+    Number reg;
+    Number pos;
+    Number *top[2];     // &stackA.top() and &stackB.top(), they never move
+    Stack *stacks[2];
+    Number steps;       // counted at jumps, as in the threaded engine
+    Number segment;     // the last jump target
+    Number nextCheck;
+};
+
+// x86-64 machine code for a whole decoded program. Every position gets its
+// own entry point in a table, because jumps take their target from the
+// stacks at run time. The instructions that are not compiled (strings, I/O,
+// random numbers, Reset, Pow, division by zero...) leave the generated code
+// so that the interpreter can execute them.
+class JitCode{
+public:
+    enum class Exit {EoF, Interpret, Check};
+
+    static bool supported();
+
+    explicit JitCode(InstructionView instructions);
+    ~JitCode();
+
+    JitCode(const JitCode&) = delete;
+    JitCode &operator=(const JitCode&) = delete;
+
+    bool valid() const;
+
+    // runs from state.pos until the end of the program, until an
+    // instruction has to be interpreted (state.pos points to it) or until
+    // state.steps reaches state.nextCheck
+    Exit run(JitState &state) const;
+
+private:
+    std::uint8_t *code;
+    std::size_t codeSize;
+    std::vector<const void*> entries;
+};
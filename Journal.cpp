@@ -0,0 +1,91 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Journal.h"
+
+#include <iterator>
+
+namespace {
+
+const char header[] = {'D', 'S', 'J', 1};
+
+}
+
+bool Journal::record(const std::string &path){
+    file.open(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+
+    replayMode = false;
+    buffer.assign(header, sizeof(header));
+    buffer.reserve(bufferSize);
+    return true;
+}
+
+bool Journal::replay(const std::string &path){
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in)
+        return false;
+
+    buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    if (buffer.compare(0, sizeof(header), header, sizeof(header)) != 0)
+        return false;
+
+    replayMode = true;
+    cursor = sizeof(header);
+    return true;
+}
+
+void Journal::write(Event event, Number value){
+    buffer += static_cast<char>(event);
+    while (value >= 0x80){
+        buffer += static_cast<char>((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    buffer += static_cast<char>(value);
+
+    if (buffer.size() >= bufferSize)
+        flush();
+}
+
+bool Journal::read(Event event, Number &value){
+    if ((cursor == buffer.size()) || (buffer[cursor] != static_cast<char>(event)))
+        return false;
+
+    value = 0;
+    for (unsigned int shift = 0; ++cursor != buffer.size(); shift += 7){
+        unsigned char byte = static_cast<unsigned char>(buffer[cursor]);
+        if (shift < 64)
+            value |= Number(byte & 0x7f) << shift;
+        if (!(byte & 0x80)){
+            ++cursor;
+            return true;
+        }
+    }
+    return false; // cut in the middle of a value
+}
+
+void Journal::flush(){
+    if (replayMode || !file.is_open())
+        return;
+
+    file.write(buffer.data(), buffer.size());
+    file.flush();
+    buffer.clear();
+}
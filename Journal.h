@@ -0,0 +1,61 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "Number.h"
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+
+// Everything a run takes from outside the program: the result of every ReadN
+// and ReadC and every number drawn by Rand, in order. A recorded journal
+// replays the same run without a terminal and without waiting for input.
+//
+// The file starts with "DSJ" and a version byte; then each event is its kind
+// ('N', 'C' or 'R') followed by the value as a LEB128 varint, so a ReadC
+// usually takes two bytes.
+class Journal{
+public:
+    enum class Event : char {ReadN = 'N', ReadC = 'C', Rand = 'R'};
+
+    // false if the file can't be created, or read, or isn't a journal
+    bool record(const std::string &path);
+    bool replay(const std::string &path);
+
+    bool replaying() const{
+        return replayMode;
+    }
+
+    void write(Event event, Number value);
+
+    // false if the next event is a different one or the journal is over
+    bool read(Event event, Number &value);
+
+    void flush();
+
+private:
+    static const std::size_t bufferSize = 64 * 1024;
+
+    std::ofstream file;
+    std::string buffer;     // recorded but not written yet, or the whole replay
+    std::size_t cursor = 0;
+    bool replayMode = false;
+};
@@ -0,0 +1,90 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "LineTable.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// what serialize() writes before the runs
+struct Header{
+    std::uint64_t runSize;
+    std::uint64_t runs;
+    std::uint64_t count;
+};
+
+}
+
+void LineTable::add(Number position, Number length, std::size_t line, std::size_t col){
+    bool follows = !runs.empty() && (runs.back().line == line) &&
+                   (runs.back().col + (position - runs.back().position) == col);
+    if (!follows)
+        runs.push_back({position, std::uint32_t(line), std::uint32_t(col)});
+    count = position + length;
+}
+
+bool LineTable::find(Number position, std::size_t &line, std::size_t &col) const{
+    if (position >= count)
+        return false;
+
+    auto after = std::upper_bound(runs.begin(), runs.end(), position, [](Number p, const Run &run){
+        return p < run.position;
+    });
+    const Run &run = *(after - 1);
+    line = run.line;
+    col = run.col + (position - run.position);
+    return true;
+}
+
+std::string LineTable::serialize() const{
+    Header header = {sizeof(Run), runs.size(), count};
+
+    std::string out(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.append(reinterpret_cast<const char*>(runs.data()), runs.size() * sizeof(Run));
+    return out;
+}
+
+bool LineTable::deserialize(std::string_view data){
+    Header header;
+    if (data.size() < sizeof(header))
+        return false;
+    std::memcpy(&header, data.data(), sizeof(header));
+    data.remove_prefix(sizeof(header));
+
+    if ((header.runSize != sizeof(Run)) || (header.runs > data.size() / sizeof(Run)) ||
+        ((header.runs == 0) != (header.count == 0)))
+        return false;
+
+    runs.resize(header.runs);
+    if (header.runs)
+        std::memcpy(runs.data(), data.data(), header.runs * sizeof(Run));
+    count = header.count;
+    return runs.empty() || (runs.front().position == 0);
+}
+
+void LineTable::clear(){
+    runs.clear();
+    count = 0;
+}
+
+void LineTable::shrink(){
+    runs.shrink_to_fit();
+}
@@ -0,0 +1,59 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "Number.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Line and column of every parsed character, for error messages, the
+// debugger and the profiler. Characters that follow each other on the same
+// line share one run, so a program takes a few bytes per character instead
+// of a tree node each. Lookups are a binary search over the runs.
+class LineTable{
+public:
+    struct Run{
+        Number position;        // of its first character
+        std::uint32_t line;
+        std::uint32_t col;
+    };
+
+    // length characters in a row from position on, the first one at
+    // line:col; they have to be added in order
+    void add(Number position, Number length, std::size_t line, std::size_t col);
+
+    // false if position was never added
+    bool find(Number position, std::size_t &line, std::size_t &col) const;
+
+    // the runs as they are laid out in memory, for program images (Image.h)
+    std::string serialize() const;
+    bool deserialize(std::string_view data);
+
+    void clear();
+    void shrink();
+
+private:
+    std::vector<Run> runs;
+    Number count = 0;           // characters up to the end of the last run
+};
@@ -0,0 +1,177 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "OutputSink.h"
+
+#include <cerrno>
+#include <charconv>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// false if the file descriptor took only part of it
+bool writeAll(int fd, const char *data, std::size_t size){
+    while (size > 0){
+#ifdef _WIN32
+        auto written = _write(fd, data, static_cast<unsigned int>(size));
+#else
+        auto written = ::write(fd, data, size);
+#endif
+        if (written < 0){
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+}
+
+OutputSink::OutputSink(int fd, Flush policy, std::size_t capacity):
+fd      (fd),
+total   (0),
+policy  (policy),
+capacity(capacity),
+broken  (false){
+    buffer.reserve(capacity);
+}
+
+OutputSink::OutputSink(Writer writer, Flush policy, std::size_t capacity):
+fd      (-1),
+writer  (std::move(writer)),
+total   (0),
+policy  (policy),
+capacity(capacity),
+broken  (false){
+    buffer.reserve(capacity);
+}
+
+OutputSink OutputSink::memory(std::size_t capacity){
+    OutputSink sink(-1, Flush::Explicit, capacity);
+    return sink;
+}
+
+OutputSink::OutputSink(OutputSink &&other):
+fd      (other.fd),
+writer  (std::move(other.writer)),
+total   (other.total),
+policy  (other.policy),
+capacity(other.capacity),
+broken  (other.broken),
+buffer  (std::move(other.buffer)){
+    other.fd = -1;
+    other.writer = nullptr;
+}
+
+OutputSink &OutputSink::operator=(OutputSink &&other){
+    if (this != &other){
+        flush();
+        fd = other.fd;
+        writer = std::move(other.writer);
+        total = other.total;
+        policy = other.policy;
+        capacity = other.capacity;
+        broken = other.broken;
+        buffer = std::move(other.buffer);
+        other.fd = -1;
+        other.writer = nullptr;
+    }
+    return *this;
+}
+
+OutputSink::~OutputSink(){
+    flush();
+}
+
+void OutputSink::setPolicy(Flush policy){
+    this->policy = policy;
+    if (policy == Flush::Line)
+        flush();
+}
+
+void OutputSink::write(const char *data, std::size_t size){
+    buffer.append(data, size);
+    if (buffer.size() >= capacity)
+        overflow();
+    else if ((policy == Flush::Line) && (buffer.find('\n', buffer.size() - size) != std::string::npos))
+        flush();
+}
+
+void OutputSink::writeNumber(std::uint64_t number){
+    char digits[20];
+    char *end = std::to_chars(digits, digits + sizeof(digits), number).ptr;
+    write(digits, end - digits);
+}
+
+void OutputSink::flush(){
+    if (inMemory() || buffer.empty())
+        return;
+
+    if (writer)
+        writer(buffer.data(), buffer.size());
+    else if (!writeAll(fd, buffer.data(), buffer.size()))
+        broken = true;
+    total += buffer.size();
+    buffer.clear();
+}
+
+std::uint64_t OutputSink::written() const{
+    return total;
+}
+
+void OutputSink::resumeAt(std::uint64_t offset){
+    total = offset;
+#ifndef _WIN32
+    struct stat info;
+    if ((fd >= 0) && (fstat(fd, &info) == 0) && S_ISREG(info.st_mode) &&
+        (std::uint64_t(info.st_size) > offset) && (ftruncate(fd, offset) == 0))
+        lseek(fd, offset, SEEK_SET); // does nothing with O_APPEND, which is fine now
+#endif
+}
+
+bool OutputSink::failed() const{
+    return broken;
+}
+
+const std::string &OutputSink::contents() const{
+    return buffer;
+}
+
+void OutputSink::clear(){
+    buffer.clear();
+}
+
+void OutputSink::overflow(){
+    if (inMemory()){
+        // memory sinks only keep the tail
+        if (buffer.size() >= capacity * 2)
+            buffer.erase(0, buffer.size() - capacity);
+    } else if ((policy != Flush::Explicit) || (buffer.size() >= capacity * 16)){
+        flush();
+    }
+}
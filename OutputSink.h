@@ -0,0 +1,101 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Where the output of the program goes. Everything is collected in a user
+// space buffer and handed to the file descriptor with a single write(2) when
+// the buffer is flushed. A writer callback can take the place of the file
+// descriptor. A memory sink never writes anywhere; it only keeps the last
+// bytes written (the debugger shows them after every step).
+class OutputSink{
+public:
+    enum class Flush {
+        Line,       // after every '\n'
+        Size,       // when the buffer is full
+        Explicit    // only when flush() is called, or if the buffer gets huge
+    };
+
+    static const std::size_t defaultCapacity = 64 * 1024;
+
+    typedef std::function<void(const char *data, std::size_t size)> Writer;
+
+    explicit OutputSink(int fd = 1, Flush policy = Flush::Size,
+                        std::size_t capacity = defaultCapacity);
+    explicit OutputSink(Writer writer, Flush policy = Flush::Size,
+                        std::size_t capacity = defaultCapacity);
+    static OutputSink memory(std::size_t capacity = defaultCapacity);
+
+    OutputSink(OutputSink &&other);
+    OutputSink &operator=(OutputSink &&other);
+    ~OutputSink();
+
+    void setPolicy(Flush policy);
+
+    void write(char ch){
+        buffer += ch;
+        if (((policy == Flush::Line) && (ch == '\n')) || (buffer.size() >= capacity))
+            overflow();
+    }
+
+    void write(const char *data, std::size_t size);
+    void write(std::string_view s){
+        write(s.data(), s.size());
+    }
+
+    // decimal, without going through a stream
+    void writeNumber(std::uint64_t number);
+
+    void flush();
+
+    // bytes handed to the file descriptor or the writer so far
+    std::uint64_t written() const;
+
+    // a write to the file descriptor went wrong (the disk is full...)
+    bool failed() const;
+
+    // Goes on from a checkpoint (Checkpoint.h) that had written offset
+    // bytes: a regular file that has more is cut back to them, so what a
+    // run wrote after its last checkpoint isn't there twice.
+    void resumeAt(std::uint64_t offset);
+
+    // what a memory sink has kept
+    const std::string &contents() const;
+    void clear();
+
+private:
+    void overflow();
+    bool inMemory() const{
+        return (fd < 0) && !writer;
+    }
+
+    int fd;                 // -1 for memory sinks and writers
+    Writer writer;
+    std::uint64_t total;
+    Flush policy;
+    std::size_t capacity;
+    bool broken;
+    std::string buffer;
+};
@@ -0,0 +1,138 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#include "PerfCounters.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+int openCounter(std::uint32_t type, std::uint64_t config){
+    perf_event_attr attributes;
+    std::memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.type = type;
+    attributes.config = config;
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+}
+
+}
+
+PerfCounters::PerfCounters(){
+    const std::uint32_t types[Count] = {
+        PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_SOFTWARE
+    };
+    const std::uint64_t configs[Count] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_SW_TASK_CLOCK
+    };
+
+    for (int i = 0; i < Count; ++i){
+        values[i] = 0;
+        fds[i] = openCounter(types[i], configs[i]);
+        if ((fds[i] < 0) && reason.empty()){
+            if ((errno == EACCES) || (errno == EPERM))
+                reason = "not allowed (see /proc/sys/kernel/perf_event_paranoid)";
+            else if ((errno == ENOENT) || (errno == ENODEV) || (errno == EOPNOTSUPP))
+                reason = "not supported by this machine (virtualized?)";
+            else
+                reason = std::strerror(errno);
+        }
+    }
+}
+
+PerfCounters::~PerfCounters(){
+    for (int fd : fds)
+        if (fd >= 0)
+            close(fd);
+}
+
+void PerfCounters::start(){
+    for (int fd : fds){
+        if (fd >= 0){
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void PerfCounters::stop(){
+    for (int i = 0; i < Count; ++i){
+        if (fds[i] < 0)
+            continue;
+
+        ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+        std::uint64_t data[3]; // value, time enabled, time running
+        if (read(fds[i], data, sizeof(data)) != sizeof(data)){
+            values[i] = 0;
+        } else if ((data[2] != 0) && (data[2] < data[1])){
+            values[i] = static_cast<std::uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]);
+        } else{
+            values[i] = data[0];
+        }
+    }
+}
+
+bool PerfCounters::available(Counter counter) const{
+    return fds[counter] >= 0;
+}
+
+#else
+
+PerfCounters::PerfCounters():
+reason("not supported on this system"){
+    for (int i = 0; i < Count; ++i){
+        fds[i] = -1;
+        values[i] = 0;
+    }
+}
+
+PerfCounters::~PerfCounters(){
+}
+
+void PerfCounters::start(){
+}
+
+void PerfCounters::stop(){
+}
+
+bool PerfCounters::available(Counter) const{
+    return false;
+}
+
+#endif
+
+std::uint64_t PerfCounters::value(Counter counter) const{
+    return values[counter];
+}
+
+const std::string &PerfCounters::error() const{
+    return reason;
+}
@@ -0,0 +1,54 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Hardware performance counters of the calling thread, through Linux
+// perf_event_open(2). Every counter is opened on its own: the ones that
+// can't be (no PMU, containers, perf_event_paranoid) are just unavailable
+// and the rest keep working. Elsewhere nothing is available.
+class PerfCounters{
+public:
+    enum Counter {Cycles, Instructions, BranchMisses, CacheMisses, TaskClock, Count};
+
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters &operator=(const PerfCounters&) = delete;
+
+    void start();
+    void stop();
+
+    bool available(Counter counter) const;
+
+    // scaled up if the kernel had to multiplex the counter; nanoseconds for
+    // TaskClock
+    std::uint64_t value(Counter counter) const;
+
+    // why the first unavailable counter couldn't be opened
+    const std::string &error() const;
+
+private:
+    int fds[Count];
+    std::uint64_t values[Count];
+    std::string reason;
+};
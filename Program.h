@@ -0,0 +1,44 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "Image.h"
+#include "LineTable.h"
+#include "Number.h"
+#include "Opcodes.h"
+#include "StringTable.h"
+
+#include <string>
+#include <vector>
+
+// Everything Interpreter::load() produces. Nothing changes it afterwards, so
+// one Program can be shared by any number of interpreters, on any number of
+// threads (Interpreter::setProgram()).
+struct Program{
+    StringTable strings;
+    std::string sourceParsed;
+    InstructionView instructions;       // decoded, or straight from the image
+    InstructionView fused;
+    std::vector<Number> constants;      // of the fused instructions, copied from the image
+    std::vector<Instruction> decoded;
+    std::vector<Instruction> decodedFused;
+    Image image;
+    LineTable lines;
+};
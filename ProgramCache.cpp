@@ -0,0 +1,80 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "ProgramCache.h"
+#include "Hash.h"
+#include "Interpreter.h"
+
+#include <iterator>
+#include <sstream>
+
+ProgramCache::ProgramCache(std::size_t capacity):
+capacity(capacity ? capacity : 1){
+}
+
+std::shared_ptr<const Program> ProgramCache::get(std::string_view text, std::string &messages){
+    std::uint64_t key = hash64(text);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (auto program = find(key, text))
+            return program;
+    }
+
+    std::ostringstream errors;
+    Interpreter loader;
+    loader.setMessages(&errors);
+    if (!loader.loadSource(text)){
+        messages = errors.str();
+        return nullptr;
+    }
+    std::shared_ptr<const Program> program = loader.program();
+
+    // another thread may have loaded it in the meantime
+    std::lock_guard<std::mutex> lock(mutex);
+    if (auto other = find(key, text))
+        return other;
+
+    entries.push_front(Entry{key, std::string(text), program});
+    index.emplace(key, entries.begin());
+    if (entries.size() > capacity){
+        Position last = std::prev(entries.end());
+        auto range = index.equal_range(last->hash);
+        for (auto i = range.first; i != range.second; ++i){
+            if (i->second == last){
+                index.erase(i);
+                break;
+            }
+        }
+        entries.pop_back();
+    }
+    return program;
+}
+
+// the text is compared too, so a collision only costs a parse
+std::shared_ptr<const Program> ProgramCache::find(std::uint64_t key, std::string_view text){
+    auto range = index.equal_range(key);
+    for (auto i = range.first; i != range.second; ++i){
+        Position entry = i->second;
+        if (entry->text != text)
+            continue;
+        entries.splice(entries.begin(), entries, entry);
+        return entry->program;
+    }
+    return nullptr;
+}
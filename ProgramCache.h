@@ -0,0 +1,66 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "Program.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Programs already parsed and decoded, found by a hash of their text, so a
+// program that is run again starts right away. It keeps up to capacity of
+// them and drops the least recently used one to make room for another.
+// Any number of threads can use it at the same time; programs are loaded
+// outside the lock.
+class ProgramCache{
+public:
+    static const std::size_t defaultCapacity = 64;
+
+    explicit ProgramCache(std::size_t capacity = defaultCapacity);
+
+    ProgramCache(const ProgramCache&) = delete;
+    ProgramCache &operator=(const ProgramCache&) = delete;
+
+    // Null if it doesn't load, with the error as dstack prints it in
+    // messages. Programs that don't load aren't kept.
+    std::shared_ptr<const Program> get(std::string_view text, std::string &messages);
+
+private:
+    struct Entry{
+        std::uint64_t hash;
+        std::string text;
+        std::shared_ptr<const Program> program;
+    };
+
+    typedef std::list<Entry>::iterator Position;
+
+    std::shared_ptr<const Program> find(std::uint64_t key, std::string_view text);
+
+    std::size_t capacity;
+    std::mutex mutex;
+    std::list<Entry> entries;   // the most recently used first
+    std::unordered_multimap<std::uint64_t, Position> index;
+};
@@ -0,0 +1,133 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Random.h"
+
+#include <chrono>
+#include <sstream>
+
+namespace {
+
+// expands the seed into the state of xoshiro256**, as its authors recommend
+std::uint64_t splitMix(std::uint64_t &x){
+    std::uint64_t z = (x += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+std::uint64_t rotate(std::uint64_t x, int k){
+    return (x << k) | (x >> (64 - k));
+}
+
+}
+
+Random::Random(Generator generator, std::uint64_t seed):
+kind    (generator),
+initial (seed),
+twister (static_cast<std::mt19937::result_type>(seed ^ (seed >> 32))){
+    std::uint64_t x = seed;
+    for (std::uint64_t &word : state)
+        word = splitMix(x);
+}
+
+std::uint64_t Random::clockSeed(){
+    return std::chrono::high_resolution_clock::now().time_since_epoch().count();
+}
+
+Random::Generator Random::generator() const{
+    return kind;
+}
+
+std::uint64_t Random::seed() const{
+    return initial;
+}
+
+std::string Random::serialize() const{
+    std::ostringstream out;
+    out << (kind == Generator::Mt19937 ? 'm' : 'x') << ' ' << initial;
+    for (std::uint64_t word : state)
+        out << ' ' << word;
+    if (kind == Generator::Mt19937)
+        out << ' ' << twister;
+    return out.str();
+}
+
+bool Random::deserialize(std::string_view data){
+    std::istringstream in{std::string(data)};
+    char generator;
+    Random restored;
+    if (!(in >> generator >> restored.initial) || ((generator != 'm') && (generator != 'x')))
+        return false;
+    for (std::uint64_t &word : restored.state)
+        if (!(in >> word))
+            return false;
+
+    restored.kind = (generator == 'm') ? Generator::Mt19937 : Generator::Xoshiro;
+    if ((restored.kind == Generator::Mt19937) && !(in >> restored.twister))
+        return false;
+
+    *this = restored;
+    return true;
+}
+
+// Lemire's multiply-and-shift: one multiplication, and a division only in the
+// rare case the draw has to be rejected to keep the result unbiased.
+Number Random::between(Number min, Number max){
+    std::uint64_t range = max - min + 1; // 0 for the whole range of Number
+    if (range == 0)
+        return next();
+
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 product = static_cast<unsigned __int128>(next()) * range;
+    std::uint64_t low = static_cast<std::uint64_t>(product);
+    if (low < range){
+        std::uint64_t threshold = (0 - range) % range;
+        while (low < threshold){
+            product = static_cast<unsigned __int128>(next()) * range;
+            low = static_cast<std::uint64_t>(product);
+        }
+    }
+    return min + static_cast<std::uint64_t>(product >> 64);
+#else
+    std::uint64_t threshold = (0 - range) % range;
+    std::uint64_t x;
+    do{
+        x = next();
+    } while (x < threshold);
+    return min + x % range;
+#endif
+}
+
+std::uint64_t Random::next(){
+    if (kind == Generator::Mt19937){
+        std::uint64_t high = twister();
+        return (high << 32) | twister();
+    }
+
+    std::uint64_t result = rotate(state[1] * 5, 7) * 9;
+    std::uint64_t t = state[1] << 17;
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = rotate(state[3], 45);
+    return result;
+}
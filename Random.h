@@ -0,0 +1,60 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "Number.h"
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+
+// Where Rand takes its numbers from. Both generators give the same sequence
+// for the same seed on every platform, so a run can be repeated with --seed.
+// xoshiro256** is the default: it is smaller and quite a bit faster than the
+// Mersenne Twister, which is kept for comparison.
+class Random{
+public:
+    enum class Generator {Xoshiro, Mt19937};
+
+    explicit Random(Generator generator = Generator::Xoshiro, std::uint64_t seed = clockSeed());
+
+    // a seed that changes from run to run
+    static std::uint64_t clockSeed();
+
+    Generator generator() const;
+    std::uint64_t seed() const;
+
+    // uniform in [min, max] (min <= max)
+    Number between(Number min, Number max);
+
+    // the whole state, as text, for checkpoints (Checkpoint.h); restoring
+    // goes on with the same sequence
+    std::string serialize() const;
+    bool deserialize(std::string_view data);
+
+private:
+    std::uint64_t next();
+
+    Generator kind;
+    std::uint64_t initial;
+    std::uint64_t state[4];
+    std::mt19937 twister;
+};
@@ -0,0 +1,86 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Scheduler.h"
+
+#include <algorithm>
+
+Scheduler::Scheduler(unsigned int threads):
+running (0),
+stopping(false){
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int i = 0; i < threads; ++i)
+        workers.emplace_back(&Scheduler::work, this);
+}
+
+Scheduler::~Scheduler(){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (auto &worker : workers)
+        worker.join();
+}
+
+void Scheduler::add(Interpreter &interpreter, Number quota, Stopped stopped, Proceed proceed){
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back({&interpreter, quota ? quota : defaultQuota, std::move(stopped), std::move(proceed)});
+    }
+    ready.notify_one();
+}
+
+void Scheduler::wait(){
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this]{
+        return queue.empty() && (running == 0);
+    });
+}
+
+void Scheduler::work(){
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;){
+        ready.wait(lock, [this]{
+            return stopping || !queue.empty();
+        });
+        if (stopping)
+            return;
+
+        Task task = std::move(queue.front());
+        queue.pop_front();
+        ++running;
+        lock.unlock();
+
+        bool success = task.interpreter->run(task.quota);
+        bool again = task.interpreter->yielded() && (!task.proceed || task.proceed(*task.interpreter));
+        if (!again && task.stopped)
+            task.stopped(*task.interpreter, success);
+
+        lock.lock();
+        --running;
+        if (again){
+            queue.push_back(std::move(task));
+            ready.notify_one();
+        } else if (queue.empty() && (running == 0)){
+            idle.notify_all();
+        }
+    }
+}
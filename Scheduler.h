@@ -0,0 +1,85 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "Interpreter.h"
+#include "Number.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs many interpreters on a few threads, taking turns: each one runs for
+// its quota of instructions (Interpreter::run()) and goes to the back of the
+// queue, so a long computation can't keep the others waiting. An
+// interpreter is only ever run by one thread at a time.
+//
+// When one stops for any other reason (it ended, failed, reached a limit or
+// waits for input) it leaves the queue and its callback is called, from the
+// worker thread. add() can put it back in, from the callback too (after
+// feeding it more input, for instance). The destructor lets the slices that
+// are running end and leaves the rest of the queue as it is.
+//
+// If it has a proceed callback, that one is asked after every slice it
+// yields from, also from the worker thread. When it says no, the interpreter
+// leaves the queue as if it had stopped (with yielded() still set) and
+// add() resumes it later.
+class Scheduler{
+public:
+    typedef std::function<void(Interpreter &interpreter, bool success)> Stopped;
+    typedef std::function<bool(Interpreter &interpreter)> Proceed;
+
+    static constexpr Number defaultQuota = 64 * 1024;
+
+    explicit Scheduler(unsigned int threads = 0);   // 0 for one per core
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler &operator=(const Scheduler&) = delete;
+
+    // the interpreter has to outlive its turn in the scheduler
+    void add(Interpreter &interpreter, Number quota = defaultQuota, Stopped stopped = nullptr,
+             Proceed proceed = nullptr);
+
+    // until no interpreter is queued or running
+    void wait();
+
+private:
+    struct Task{
+        Interpreter *interpreter;
+        Number quota;
+        Stopped stopped;
+        Proceed proceed;
+    };
+
+    void work();
+
+    std::mutex mutex;
+    std::condition_variable ready;      // something in the queue, or stopping
+    std::condition_variable idle;       // nothing queued nor running
+    std::deque<Task> queue;
+    std::size_t running;
+    bool stopping;
+    std::vector<std::thread> workers;
+};
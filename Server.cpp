@@ -0,0 +1,405 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Server.h"
+#include "Connection.h"
+#include "Files.h"
+#include "Image.h"
+#include "Interpreter.h"
+#include "Scheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// instructions a run goes on for before another one takes its turn
+const Number quota = 1024 * 1024;
+
+// bytes of output waiting for a client beyond which its run sits out
+const std::size_t backlog = 1024 * 1024;
+
+}
+
+// One connection, from the settings to the exit status. Only run() (the
+// polling thread) looks at the state; while the run is Running the
+// interpreter belongs to the scheduler.
+struct Server::Session{
+    enum class State {Starting, Running, Waiting, Held, Closing, Done};
+
+    explicit Session(int fd):
+    client      (fd),
+    state       (State::Starting),
+    configured  (false),
+    success     (true),
+    gone        (false){
+    }
+
+    // without waiting, from a worker too
+    void post(Connection::Kind kind, std::string_view data){
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!client.post(kind, data))
+            gone = true;
+    }
+
+    // the exit status of dstack
+    void finish(const std::string &messages, int status){
+        if (!messages.empty())
+            post(Connection::Kind::Message, messages);
+        post(Connection::Kind::Exit, std::to_string(status));
+        state = State::Closing;
+    }
+
+    Connection client;
+    State state;
+    bool configured;                // the settings came
+    Connection::Settings settings;
+    std::unique_ptr<Interpreter> interpreter;
+    std::ostringstream errors;
+    bool success;                   // how the run stopped
+    std::mutex mutex;               // for the output, sent by a worker and flushed by run()
+    std::atomic<bool> gone;         // the client went away
+};
+
+Server::Server(const Settings &settings):
+settings        (settings),
+cache           (settings.programs),
+listener        (-1),
+wake            {-1, -1},
+keptInterpreters(0){
+}
+
+Server::~Server(){
+#ifndef _WIN32
+    for (int fd : {listener, wake[0], wake[1]})
+        if (fd >= 0)
+            ::close(fd);
+#endif
+}
+
+bool Server::listen(const std::string &path){
+#ifndef _WIN32
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)){
+        message = "The socket path is too long (" + path + ")";
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    Connection probe;
+    if (probe.connect(path)){
+        message = "There is a server running already (" + path + ")";
+        return false;
+    }
+    struct stat status;
+    if ((lstat(path.c_str(), &status) == 0) && S_ISSOCK(status.st_mode))
+        ::unlink(path.c_str());
+
+    listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if ((listener >= 0) &&
+        (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0) &&
+        (::listen(listener, SOMAXCONN) == 0))
+        return true;
+
+    message = "Could not listen on " + path + ": " + std::strerror(errno);
+    return false;
+#else
+    message = "UNIX domain sockets are not supported on this system";
+    (void)path;
+    return false;
+#endif
+}
+
+const std::string &Server::error() const{
+    return message;
+}
+
+void Server::run(){
+#ifndef _WIN32
+    if (::pipe(wake) != 0){
+        message = std::string("Could not create a pipe: ") + std::strerror(errno);
+        return;
+    }
+    for (int fd : {wake[0], wake[1], listener})
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    unsigned int threads = settings.threads ? settings.threads : std::max(1u, std::thread::hardware_concurrency());
+    keptInterpreters = threads;
+    Scheduler scheduler(threads);
+
+    std::vector<pollfd> polled;
+    for (;;){
+        // the wake pipe, the listener and then every session, in order
+        polled.clear();
+        polled.push_back({wake[0], POLLIN, 0});
+        polled.push_back({listener, POLLIN, 0});
+        for (auto &session : sessions){
+            short events = 0;
+            if ((session->state == Session::State::Starting) || (session->state == Session::State::Waiting))
+                events |= POLLIN;
+            {
+                std::lock_guard<std::mutex> lock(session->mutex);
+                if (session->client.queued())
+                    events |= POLLOUT;
+            }
+            // a hang-up is told even with no events, but only once is enough
+            polled.push_back({session->gone ? -1 : session->client.descriptor(), events, 0});
+        }
+
+        if (::poll(polled.data(), polled.size(), -1) < 0){
+            if (errno == EINTR)
+                continue;
+            message = std::string("Could not poll the connections: ") + std::strerror(errno);
+            break;
+        }
+
+        for (std::size_t i = 0; i < sessions.size(); ++i){
+            Session &session = *sessions[i];
+            short events = polled[i + 2].revents;
+            if (events & POLLOUT){
+                std::lock_guard<std::mutex> lock(session.mutex);
+                if (!session.client.flush())
+                    session.gone = true;
+            }
+            if (events & (POLLIN | POLLHUP | POLLERR)){
+                if (((session.state == Session::State::Starting) || (session.state == Session::State::Waiting)) &&
+                    session.client.collect())
+                    receive(session, scheduler);
+                else
+                    session.gone = true;
+            }
+        }
+
+        if (polled[0].revents & POLLIN){
+            char bytes[64];
+            while (::read(wake[0], bytes, sizeof(bytes)) > 0)
+                ;
+            std::vector<Session*> stopped;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopped.swap(handed);
+            }
+            for (Session *session : stopped)
+                settle(*session);
+        }
+
+        if (polled[1].revents & POLLIN){
+            int fd = ::accept(listener, nullptr, nullptr);
+            if (fd >= 0){
+                ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+                sessions.push_back(std::make_unique<Session>(fd));
+            } else if ((errno != EINTR) && (errno != ECONNABORTED) && (errno != EAGAIN)){
+                message = std::string("Could not accept connections: ") + std::strerror(errno);
+                break;
+            }
+        }
+
+        for (auto &session : sessions){
+            if (session->state == Session::State::Waiting)
+                receive(*session, scheduler);   // what came while it ran
+            if (session->state == Session::State::Running)
+                continue;
+            if (session->gone)
+                discard(*session);
+            else if ((session->state == Session::State::Held) && (session->client.queued() < backlog))
+                resume(*session, scheduler);
+            else if ((session->state == Session::State::Closing) && !session->client.queued())
+                discard(*session);
+        }
+        sessions.erase(std::remove_if(sessions.begin(), sessions.end(), [](const std::unique_ptr<Session> &session){
+            return session->state == Session::State::Done;
+        }), sessions.end());
+    }
+#endif
+}
+
+// the messages already collected, while the session is starting or waiting
+// for input; the rest wait for their turn
+void Server::receive(Session &session, Scheduler &scheduler){
+    Connection::Kind kind;
+    std::string data;
+    while (((session.state == Session::State::Starting) || (session.state == Session::State::Waiting)) &&
+           !session.gone && session.client.take(kind, data))
+        handle(session, kind, data, scheduler);
+    if (!session.client.valid())
+        session.gone = true;
+}
+
+void Server::handle(Session &session, Connection::Kind kind, const std::string &data, Scheduler &scheduler){
+    if (session.state == Session::State::Waiting){
+        if (kind == Connection::Kind::Input)
+            session.interpreter->feedInput(data);
+        else if (kind == Connection::Kind::EndOfInput)
+            session.interpreter->closeInput();
+        else
+            return;
+        resume(session, scheduler);
+        return;
+    }
+
+    if (!session.configured){
+        Connection::Settings &received = session.settings;
+        if ((kind != Connection::Kind::Settings) || (data.size() != sizeof(received))){
+            session.gone = true;
+            return;
+        }
+        std::memcpy(&received, data.data(), sizeof(received));
+        if ((received.version != Connection::version) || (received.engine > static_cast<std::uint8_t>(Engine::Jit)) ||
+            (received.flush > 2) || (received.generator > 1)){
+            session.finish("The client doesn't match this server\n", 2);
+            return;
+        }
+        session.configured = true;
+        return;
+    }
+
+    std::string messages;
+    std::shared_ptr<const Program> program;
+    if (kind == Connection::Kind::Source)
+        program = cache.get(data, messages);
+    else if (kind == Connection::Kind::Path)
+        program = loadFile(data, messages);
+    if (program)
+        start(session, program, scheduler);
+    else if ((kind == Connection::Kind::Source) || (kind == Connection::Kind::Path))
+        session.finish(messages, 2);
+    else
+        session.gone = true;
+}
+
+void Server::start(Session &session, std::shared_ptr<const Program> program, Scheduler &scheduler){
+    const Connection::Settings &received = session.settings;
+    Limits limits;
+    limits.steps = received.steps;
+    limits.depth = static_cast<std::size_t>(received.depth);
+    limits.memory = static_cast<std::size_t>(received.memory);
+    limits.seconds = received.seconds;
+
+    if (idle.empty()){
+        session.interpreter = std::make_unique<Interpreter>();
+    } else{
+        session.interpreter = std::move(idle.back());
+        idle.pop_back();
+    }
+
+    Interpreter &interpreter = *session.interpreter;
+    interpreter.reset();
+    interpreter.setProgram(program);
+    interpreter.setMessages(&session.errors);
+    interpreter.setEngine(static_cast<Engine>(received.engine));
+    interpreter.setLimits(limits);
+    interpreter.setRandom(static_cast<Random::Generator>(received.generator), received.seed);
+
+    // what the client can't take now is flushed by run(), which is told
+    Session *running = &session;
+    interpreter.setOutput([this, running](const char *data, std::size_t size){
+        bool backedUp;
+        {
+            std::lock_guard<std::mutex> lock(running->mutex);
+            bool before = running->client.queued() > 0;
+            if (!running->client.post(Connection::Kind::Output, std::string_view(data, size)))
+                running->gone = true;
+            backedUp = !before && running->client.queued();
+        }
+        if (backedUp)
+            notify();
+    });
+    interpreter.setFlushPolicy(static_cast<OutputSink::Flush>(received.flush));
+    interpreter.suspendOnInput();
+    resume(session, scheduler);
+}
+
+// back in the scheduler, until the run stops, waits for input, piles up
+// output or loses its client
+void Server::resume(Session &session, Scheduler &scheduler){
+    Session *running = &session;
+    session.state = Session::State::Running;
+    scheduler.add(*session.interpreter, quota, [this, running](Interpreter&, bool success){
+        running->success = success;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            handed.push_back(running);
+        }
+        notify();
+    }, [running](Interpreter&){
+        std::lock_guard<std::mutex> lock(running->mutex);
+        return !running->gone && (running->client.queued() < backlog);
+    });
+}
+
+// a session the scheduler handed back
+void Server::settle(Session &session){
+    Interpreter &interpreter = *session.interpreter;
+    if (interpreter.yielded())
+        session.state = Session::State::Held;
+    else if (session.success && interpreter.waitingForInput())
+        session.state = Session::State::Waiting;
+    else
+        session.finish(session.errors.str(), session.success ? 0 : (interpreter.limitReached() ? 4 : 3));
+}
+
+// its interpreter is kept for another run
+void Server::discard(Session &session){
+    if (session.interpreter && (idle.size() < keptInterpreters)){
+        session.interpreter->setOutput(nullptr);
+        session.interpreter->setMessages(nullptr);
+        idle.push_back(std::move(session.interpreter));
+    }
+    session.state = Session::State::Done;
+}
+
+void Server::notify(){
+#ifndef _WIN32
+    char byte = 0;
+    while ((::write(wake[1], &byte, 1) < 0) && (errno == EINTR))
+        ;
+#endif
+}
+
+// images aren't parsed, so there is nothing to keep for them
+std::shared_ptr<const Program> Server::loadFile(const std::string &path, std::string &messages){
+    Image image;
+    std::string text;
+    if ((image.open(path) == Image::Result::NotImage) && readFile(path, text))
+        return cache.get(text, messages);
+
+    std::ostringstream errors;
+    Interpreter loader;
+    loader.setMessages(&errors);
+    if (loader.load(path))
+        return loader.program();
+
+    messages = errors.str();
+    return nullptr;
+}
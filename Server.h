@@ -0,0 +1,94 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#pragma once
+
+#include "Connection.h"
+#include "Program.h"
+#include "ProgramCache.h"
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Interpreter;
+class Scheduler;
+
+// dstack --serve: runs programs for the clients (Client.h) that connect to
+// a UNIX domain socket, so they skip starting a process and loading the
+// program. Programs sent as text are kept in a ProgramCache; images are
+// mapped again for every run.
+//
+// No thread belongs to a connection. One thread polls the sockets: it
+// accepts connections, reads their settings, program and input, and writes
+// the output a client couldn't take right away, never waiting for any of
+// them (a message is only looked at once all of it came). The runs themselves take
+// turns on the threads of a Scheduler (Scheduler.h). A run waiting for input
+// (Interpreter::suspendOnInput()) leaves the scheduler until its client
+// sends more, and so does one with more output piled up than its client
+// takes, until it does; a run whose client went away is stopped at the end
+// of its slice. Interpreters that finish are kept for the runs that come
+// next (as many as there are threads), with their memory and, if the same
+// program comes again, their compiled code.
+class Server{
+public:
+    struct Settings{
+        unsigned int threads = 0;       // 0 for one per core
+        std::size_t programs = ProgramCache::defaultCapacity;
+    };
+
+    explicit Server(const Settings &settings);
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server &operator=(const Server&) = delete;
+
+    // A socket file left by a server that is gone is replaced; one with a
+    // server still behind it is not.
+    bool listen(const std::string &path);
+    const std::string &error() const;
+
+    // only returns if accepting connections fails
+    void run();
+
+private:
+    struct Session;
+
+    void receive(Session &session, Scheduler &scheduler);
+    void handle(Session &session, Connection::Kind kind, const std::string &data, Scheduler &scheduler);
+    void start(Session &session, std::shared_ptr<const Program> program, Scheduler &scheduler);
+    void resume(Session &session, Scheduler &scheduler);
+    void settle(Session &session);
+    void discard(Session &session);
+    void notify();
+    std::shared_ptr<const Program> loadFile(const std::string &path, std::string &messages);
+
+    Settings settings;
+    ProgramCache cache;
+    int listener;
+    int wake[2];                // a pipe, written to when a session is handed back
+    std::string message;
+    std::vector<std::unique_ptr<Session>> sessions;     // only used by run()
+    std::vector<std::unique_ptr<Interpreter>> idle;
+    std::size_t keptInterpreters;
+    std::mutex mutex;
+    std::vector<Session*> handed;       // by the workers, whose runs stopped
+};
@@ -0,0 +1,126 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#include "Stack.h"
+
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const std::size_t initialCapacity = 256;
+const std::size_t sizeClasses = 10;
+const std::size_t keptPerClass = 4;
+const std::size_t largestKept = initialCapacity << (sizeClasses - 1);  // values (1 MiB)
+
+// Released buffers, by size class (initialCapacity << class). Only a few of
+// each are kept, none bigger than largestKept; they are given back to the
+// allocator when the thread ends.
+struct Pool{
+    std::vector<Number*> free[sizeClasses];
+
+    ~Pool();
+};
+
+thread_local Pool pool;
+
+// Stacks destroyed after the pool (static or thread_local ones) free their
+// buffers directly; the flag has no destructor, so it outlives the pool.
+thread_local bool poolGone = false;
+
+Pool::~Pool(){
+    poolGone = true;
+    for (auto &buffers : free)
+        for (Number *buffer : buffers)
+            delete[] buffer;
+}
+
+std::size_t sizeClass(std::size_t capacity){
+    std::size_t c = 0;
+    while ((initialCapacity << c) < capacity)
+        ++c;
+    return c;
+}
+
+Number *acquire(std::size_t capacity){
+    std::size_t c = sizeClass(capacity);
+    if (!poolGone && (c < sizeClasses) && !pool.free[c].empty()){
+        Number *buffer = pool.free[c].back();
+        pool.free[c].pop_back();
+        return buffer;
+    }
+    return new Number[capacity];
+}
+
+void release(Number *buffer, std::size_t capacity){
+    std::size_t c = sizeClass(capacity);
+    if (!poolGone && (c < sizeClasses) && (pool.free[c].size() < keptPerClass))
+        pool.free[c].push_back(buffer);
+    else
+        delete[] buffer;
+}
+
+}
+
+Stack::Stack():
+value(0){
+    base = acquire(initialCapacity);
+    base[0] = 0;
+    below = base;
+    limit = base + initialCapacity;
+}
+
+Stack::~Stack(){
+    release(base, limit - base);
+}
+
+void Stack::shrink(){
+    if (std::size_t(limit - base) > largestKept){
+        release(base, limit - base);
+        base = acquire(initialCapacity);
+        base[0] = 0;
+        limit = base + initialCapacity;
+    }
+    clear();
+}
+
+void Stack::append(const Number *values, std::size_t count){
+    if (count == 0)
+        return;
+    if (below + count >= limit)
+        grow(count);
+    *++below = value;
+    std::memcpy(below + 1, values, (count - 1) * sizeof(Number));
+    below += count - 1;
+    value = values[count - 1];
+}
+
+void Stack::grow(std::size_t extra){
+    std::size_t used = below - base + 1;
+    std::size_t capacity = limit - base;
+    while (capacity < used + extra + 1)
+        capacity *= 2;
+
+    Number *buffer = acquire(capacity);
+    std::memcpy(buffer, base, used * sizeof(Number));
+    release(base, limit - base);
+
+    base = buffer;
+    below = base + used - 1;
+    limit = base + capacity;
+}
@@ -0,0 +1,102 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#pragma once
+
+#include "Number.h"
+
+#include <cstddef>
+
+// One of the two stacks of the language. The top value is kept apart from
+// the rest, so reading it never touches the buffer, and the buffer starts
+// with a zero that is never removed: popping the last value leaves that zero
+// on top, which is exactly the "never empty" rule, without a branch.
+//
+// The buffer grows by doubling and comes from a per-thread pool, so short
+// runs don't go back to the allocator every time. Only buffers of up to 1 MiB
+// are pooled; bigger ones go back to the allocator as soon as they are let go.
+class Stack{
+public:
+    Stack();
+    ~Stack();
+
+    Stack(const Stack&) = delete;
+    Stack &operator=(const Stack&) = delete;
+
+    Number &top(){
+        return value;
+    }
+
+    Number top() const{
+        return value;
+    }
+
+    void push(Number number){
+        if (below + 1 == limit)
+            grow(1);
+        *++below = value;
+        value = number;
+    }
+
+    void pop(){
+        value = *below;
+        below -= (below != base);
+    }
+
+    // pushes count values, the last one ends up on top
+    void append(const Number *values, std::size_t count);
+
+    // back to the single zero
+    void clear(){
+        below = base;
+        value = 0;
+    }
+
+    // clear(), and a buffer that grew past what the pool keeps is given back
+    // for a small one
+    void shrink();
+
+    std::size_t size() const{
+        return (below - base) + 1;
+    }
+
+    // bytes taken by the buffer
+    std::size_t memory() const{
+        return (limit - base) * sizeof(Number);
+    }
+
+    // from the bottom
+    Number operator[](std::size_t index) const{
+        return (index + 1 < size()) ? base[index + 1] : value;
+    }
+
+    // the size() - 1 values under the top one, from the bottom
+    const Number *lower() const{
+        return base + 1;
+    }
+
+private:
+    friend struct StackLayout; // the JIT pushes and pops inline (Jit.cpp)
+
+    void grow(std::size_t extra);
+
+    Number value;
+    Number *below;      // the value under the top one (base if there is none)
+    Number *base;       // always holds 0
+    Number *limit;
+};
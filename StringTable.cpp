@@ -0,0 +1,161 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#include "StringTable.h"
+
+#include <cstring>
+
+namespace {
+
+// what serialize() writes before the arrays
+struct Header{
+    std::uint64_t entrySize;
+    std::uint64_t segmentSize;
+    std::uint64_t entries;
+    std::uint64_t text;
+    std::uint64_t values;
+    std::uint64_t segments;
+};
+
+// every array starts at a multiple of 8 bytes
+std::size_t padded(std::size_t size){
+    return (size + 7) & ~std::size_t(7);
+}
+
+void append(std::string &out, const void *data, std::size_t size){
+    out.append(static_cast<const char*>(data), size);
+    out.append(padded(size) - size, '\0');
+}
+
+template<class T>
+bool take(std::string_view &data, std::size_t count, T &array){
+    std::size_t size = count * sizeof(typename T::value_type);
+    if ((count > data.size()) || (padded(size) > data.size()))
+        return false;
+    array.resize(count);
+    if (size)
+        std::memcpy(&array[0], data.data(), size);
+    data.remove_prefix(padded(size));
+    return true;
+}
+
+}
+
+StringTable::StringTable(const std::map<Number, std::string> &strings){
+    std::size_t total = 0;
+    for (const auto &entry : strings)
+        total += entry.second.length();
+
+    table.reserve(strings.size());
+    arena.reserve(total);
+    valueArena.reserve(total * 2);
+
+    for (const auto &entry : strings){
+        const std::string &s = entry.second;
+
+        Entry e;
+        e.id = entry.first;
+        e.text = arena.size();
+        e.values = valueArena.size();
+        e.length = s.length();
+        e.segments = segmentArena.size();
+        e.usesFirst = false;
+        e.usesSecond = false;
+
+        arena += s;
+        for (char ch : s)
+            valueArena.push_back(Number(ch));
+        for (auto it = s.rbegin(); it != s.rend(); ++it)
+            valueArena.push_back(Number(*it));
+
+        std::uint32_t begin = 0;
+        for (std::uint32_t i = 0; i < s.length(); ++i){
+            if ((s[i] != '#') && (s[i] != '$'))
+                continue;
+            if (i > begin)
+                segmentArena.push_back({Segment::Kind::Text, begin, i - begin});
+            if (s[i] == '#'){
+                segmentArena.push_back({Segment::Kind::First, i, 1});
+                e.usesFirst = true;
+            } else{
+                segmentArena.push_back({Segment::Kind::Second, i, 1});
+                e.usesSecond = true;
+            }
+            begin = i + 1;
+        }
+        if (s.length() > begin)
+            segmentArena.push_back({Segment::Kind::Text, begin, std::uint32_t(s.length() - begin)});
+        e.segmentCount = segmentArena.size() - e.segments;
+        table.push_back(e);
+    }
+
+    buildIndex();
+}
+
+std::string StringTable::serialize() const{
+    Header header = {sizeof(Entry), sizeof(Segment), table.size(), arena.size(),
+                     valueArena.size(), segmentArena.size()};
+
+    std::string out;
+    append(out, &header, sizeof(header));
+    append(out, table.data(), table.size() * sizeof(Entry));
+    append(out, arena.data(), arena.size());
+    append(out, valueArena.data(), valueArena.size() * sizeof(Number));
+    append(out, segmentArena.data(), segmentArena.size() * sizeof(Segment));
+    return out;
+}
+
+bool StringTable::deserialize(std::string_view data){
+    Header header;
+    if (data.size() < sizeof(header))
+        return false;
+    std::memcpy(&header, data.data(), sizeof(header));
+    data.remove_prefix(padded(sizeof(header)));
+
+    if ((header.entrySize != sizeof(Entry)) || (header.segmentSize != sizeof(Segment)))
+        return false;
+    if (!take(data, header.entries, table) || !take(data, header.text, arena) ||
+        !take(data, header.values, valueArena) || !take(data, header.segments, segmentArena))
+        return false;
+
+    for (const Entry &e : table){
+        if ((e.text + e.length > arena.size()) || (e.values + e.length * 2 > valueArena.size()) ||
+            (e.segments + e.segmentCount > segmentArena.size()))
+            return false;
+    }
+
+    buildIndex();
+    return true;
+}
+
+void StringTable::buildIndex(){
+    Number largest = 0;
+    for (const Entry &e : table){
+        if (e.id < denseLimit)
+            largest = e.id + 1;
+    }
+
+    index.assign(largest, 0);
+    sparse.clear();
+    for (std::uint32_t i = 0; i < table.size(); ++i){
+        if (table[i].id < denseLimit)
+            index[table[i].id] = i + 1;
+        else
+            sparse.emplace(table[i].id, i);
+    }
+}
@@ -0,0 +1,109 @@
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+#pragma once
+
+#include "Number.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// The string literals of a program, laid out once at load time. The text of
+// every string lives in one arena; the values PushS and PushRS put on a stack
+// live in another one, already in both orders. Small ids are found through a
+// flat index and the rest through a hash table.
+class StringTable{
+public:
+    // a piece of a string as PrintSiN and PrintSiC see it: plain text, or
+    // a '#' (first value) or '$' (second value) placeholder
+    struct Segment{
+        enum class Kind {Text, First, Second};
+        Kind kind;
+        std::uint32_t offset;   // from the beginning of the string
+        std::uint32_t length;
+    };
+
+    struct Entry{
+        Number id;
+        std::size_t text;       // in the text arena
+        std::size_t values;     // in the value arena, reversed ones follow
+        std::size_t length;
+        std::size_t segments;
+        std::size_t segmentCount;
+        bool usesFirst;
+        bool usesSecond;
+    };
+
+    StringTable() = default;
+    explicit StringTable(const std::map<Number, std::string> &strings);
+
+    // The arrays as they are laid out in memory, for program images
+    // (Image.h). Restoring copies them back and only rebuilds the index;
+    // false if the data doesn't come from a build with the same layout.
+    std::string serialize() const;
+    bool deserialize(std::string_view data);
+
+    // nullptr if there is no string with that id
+    const Entry *find(Number id) const{
+        if (id < index.size()){
+            std::uint32_t i = index[id];
+            return i ? &table[i - 1] : nullptr;
+        }
+        auto found = sparse.find(id);
+        return (found != sparse.end()) ? &table[found->second] : nullptr;
+    }
+
+    std::string_view text(const Entry &entry) const{
+        return std::string_view(arena.data() + entry.text, entry.length);
+    }
+
+    const Number *values(const Entry &entry, bool reversed) const{
+        return valueArena.data() + entry.values + (reversed ? entry.length : 0);
+    }
+
+    const Segment *segments(const Entry &entry) const{
+        return segmentArena.data() + entry.segments;
+    }
+
+    // sorted by id
+    const std::vector<Entry> &entries() const{
+        return table;
+    }
+
+    bool empty() const{
+        return table.empty();
+    }
+
+private:
+    // ids below this one go to the flat index
+    static const Number denseLimit = 64 * 1024;
+
+    void buildIndex();
+
+    std::vector<Entry> table;
+    std::vector<std::uint32_t> index;   // position in table + 1, 0 if absent
+    std::unordered_map<Number, std::uint32_t> sparse;
+    std::string arena;
+    std::vector<Number> valueArena;
+    std::vector<Segment> segmentArena;
+};
@@ -1,71 +1,550 @@
-/*
-DStack - Interpreter for the esoteric programming language DStack.
-Copyright (C) 2015 Alejandro O. Coria Bayer
-
-This program is free software; you can redistribute it and/or
-modify it under the terms of the GNU General Public License
-as published by the Free Software Foundation; either version 2
-of the License, or (at your option) any later version.
-
-This program is distributed in the hope that it will be useful,
-but WITHOUT ANY WARRANTY; without even the implied warranty of
-MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
-GNU General Public License for more details.
-
-You should have received a copy of the GNU General Public License
-along with this program; if not, write to the Free Software
-Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
-*/
-
-#include "Interpreter.h"
-
-#include <cstring>
-#include <iostream>
-
-void usage();
-
-int main(int argc, char *argv[]) {
-    bool debug = false;
-    char *file;
-
-    if (argc < 2){
-        usage();
-        exit(0);
-    } else if (argc > 3){
-        std::cout << "too many arguments\n\n";
-        usage();
-        exit(0);
-    }
-
-    if (argc == 3){
-        if (std::strcmp(argv[1], "-d") == 0){
-            debug = true;
-            file = argv[2];
-        } else if (std::strcmp(argv[2], "-d") == 0){
-            debug = true;
-            file = argv[1];
-        } else{
-            std::cout << "error in arguments\n\n";
-            usage();
-            exit(0);
-        }
-    } else{
-        file = argv[1];
-    }
-
-	Interpreter interpreter{debug};
-
-	if(!interpreter.load(file))
-		return 2;
-
-	if(!interpreter.execute())
-		return 3;
-
-	return 0;
-}
-
-void usage(){
-    std::cout << "dstack [-d] file\n\n";
-    std::cout << "    -d\tDisplay debugging information while running\n";
-    std::cout << "    file\tName of the file to be executed\n\n";
-}
+/*
+DStack - Interpreter for the esoteric programming language DStack.
+Copyright (C) 2015 Alejandro O. Coria Bayer
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "Batch.h"
+#include "Client.h"
+#include "Interpreter.h"
+#include "PerfCounters.h"
+#include "Server.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+
+void usage();
+bool parseSize(const char *text, std::size_t &size);
+void printStats(const Interpreter &interpreter, const PerfCounters &counters, double loadSeconds, double seconds);
+
+int main(int argc, char *argv[]) {
+    bool debug = false;
+    bool emitCpp = false;
+    bool mapInput = false;
+    bool stats = false;
+    Engine engine = Engine::Switch;
+    OutputSink::Flush flush = OutputSink::Flush::Size;
+    Limits limits;
+    Random::Generator generator = Random::Generator::Xoshiro;
+    Number seed = Random::clockSeed();
+    char *profile = nullptr;
+    char *image = nullptr;
+    char *record = nullptr;
+    char *replay = nullptr;
+    char *batch = nullptr;
+    char *checkpoint = nullptr;
+    char *resume = nullptr;
+    double checkpointEvery = 60;
+    unsigned int threads = 0;
+    char *serve = nullptr;
+    char *connect = nullptr;
+    std::size_t programs = ProgramCache::defaultCapacity;
+    char *file = nullptr;
+
+    if (argc < 2){
+        usage();
+        exit(0);
+    }
+
+    for (int i = 1; i < argc; ++i){
+        if (std::strcmp(argv[i], "-d") == 0){
+            debug = true;
+        } else if (std::strcmp(argv[i], "--emit-cpp") == 0){
+            emitCpp = true;
+        } else if (std::strcmp(argv[i], "--compile") == 0){
+            if (++i == argc){
+                std::cout << "missing image file\n\n";
+                usage();
+                exit(0);
+            }
+            image = argv[i];
+        } else if (std::strcmp(argv[i], "--batch") == 0){
+            if (++i == argc){
+                std::cout << "missing manifest file\n\n";
+                usage();
+                exit(0);
+            }
+            batch = argv[i];
+        } else if ((std::strcmp(argv[i], "--serve") == 0) ||
+                   (std::strcmp(argv[i], "--connect") == 0)){
+            bool serving = std::strcmp(argv[i], "--serve") == 0;
+            if (++i == argc){
+                std::cout << "missing socket\n\n";
+                usage();
+                exit(0);
+            }
+            (serving ? serve : connect) = argv[i];
+        } else if (std::strcmp(argv[i], "--cache") == 0){
+            if (++i == argc){
+                std::cout << "missing number of programs\n\n";
+                usage();
+                exit(0);
+            }
+            if (!parseSize(argv[i], programs)){
+                std::cout << "invalid number of programs (" << argv[i] << ")\n\n";
+                usage();
+                exit(0);
+            }
+        } else if (std::strcmp(argv[i], "--jobs") == 0){
+            if (++i == argc){
+                std::cout << "missing number of threads\n\n";
+                usage();
+                exit(0);
+            }
+
+            char *end;
+            unsigned long count = std::strtoul(argv[i], &end, 10);
+            if ((end == argv[i]) || (*end != '\0') || (*argv[i] == '-') || (count == 0) || (count > 4096)){
+                std::cout << "invalid number of threads (" << argv[i] << ")\n\n";
+                usage();
+                exit(0);
+            }
+            threads = static_cast<unsigned int>(count);
+        } else if ((std::strcmp(argv[i], "--checkpoint") == 0) ||
+                   (std::strcmp(argv[i], "--resume") == 0)){
+            bool writing = std::strcmp(argv[i], "--checkpoint") == 0;
+            if (++i == argc){
+                std::cout << "missing checkpoint file\n\n";
+                usage();
+                exit(0);
+            }
+            (writing ? checkpoint : resume) = argv[i];
+        } else if (std::strcmp(argv[i], "--checkpoint-every") == 0){
+            if (++i == argc){
+                std::cout << "missing checkpoint interval\n\n";
+                usage();
+                exit(0);
+            }
+
+            char *end;
+            checkpointEvery = std::strtod(argv[i], &end);
+            if ((end == argv[i]) || (*end != '\0') || !(checkpointEvery > 0)){
+                std::cout << "invalid checkpoint interval (" << argv[i] << ")\n\n";
+                usage();
+                exit(0);
+            }
+        } else if (std::strcmp(argv[i], "--mmap-input") == 0){
+            mapInput = true;
+        } else if (std::strcmp(argv[i], "--stats") == 0){
+            stats = true;
+        } else if (std::strcmp(argv[i], "--profile") == 0){
+            if (++i == argc){
+                std::cout << "missing profile file\n\n";
+                usage();
+                exit(0);
+            }
+            profile = argv[i];
+        } else if ((std::strcmp(argv[i], "--record") == 0) ||
+                   (std::strcmp(argv[i], "--replay") == 0)){
+            bool recording = std::strcmp(argv[i], "--record") == 0;
+            if (++i == argc){
+                std::cout << "missing journal file\n\n";
+                usage();
+                exit(0);
+            }
+            (recording ? record : replay) = argv[i];
+        } else if (std::strcmp(argv[i], "--seed") == 0){
+            if (++i == argc){
+                std::cout << "missing seed\n\n";
+                usage();
+                exit(0);
+            }
+
+            char *end;
+            seed = std::strtoull(argv[i], &end, 10);
+            if ((end == argv[i]) || (*end != '\0') || (*argv[i] == '-')){
+                std::cout << "invalid seed (" << argv[i] << ")\n\n";
+                usage();
+                exit(0);
+            }
+        } else if (std::strcmp(argv[i], "--random") == 0){
+            if (++i == argc){
+                std::cout << "missing generator name\n\n";
+                usage();
+                exit(0);
+            }
+
+            if (std::strcmp(argv[i], "xoshiro") == 0){
+                generator = Random::Generator::Xoshiro;
+            } else if (std::strcmp(argv[i], "mt19937") == 0){
+                generator = Random::Generator::Mt19937;
+            } else{
+                std::cout << "unknown generator (" << argv[i] << ")\n\n";
+                usage();
+                exit(0);
+            }
+        } else if (std::strcmp(argv[i], "-e") == 0){
+            if (++i == argc){
+                std::cout << "missing engine name\n\n";
+                usage();
+                exit(0);
+            }
+
+            if (std::strcmp(argv[i], "switch") == 0){
+                engine = Engine::Switch;
+            } else if (std::strcmp(argv[i], "threaded") == 0){
+                engine = Engine::Threaded;
+            } else if (std::strcmp(argv[i], "blocks") == 0){
+                engine = Engine::Blocks;
+            } else if (std::strcmp(argv[i], "jit") == 0){
+                engine = Engine::Jit;
+            } else{
+                std::cout << "unknown engine (" << argv[i] << ")\n\n";
+                usage();
+                exit(0);
+            }
+        } else if (std::strcmp(argv[i], "--flush") == 0){
+            if (++i == argc){
+                std::cout << "missing flush policy\n\n";
+                usage();
+                exit(0);
+            }
+
+            if (std::strcmp(argv[i], "line") == 0){
+                flush = OutputSink::Flush::Line;
+            } else if (std::strcmp(argv[i], "size") == 0){
+                flush = OutputSink::Flush::Size;
+            } else if (std::strcmp(argv[i], "explicit") == 0){
+                flush = OutputSink::Flush::Explicit;
+            } else{
+                std::cout << "unknown flush policy (" << argv[i] << ")\n\n";
+                usage();
+                exit(0);
+            }
+        } else if ((std::strcmp(argv[i], "--max-steps") == 0) ||
+                   (std::strcmp(argv[i], "--max-depth") == 0) ||
+                   (std::strcmp(argv[i], "--max-memory") == 0) ||
+                   (std::strcmp(argv[i], "--max-time") == 0)){
+            const char *option = argv[i];
+            if (++i == argc){
+                std::cout << "missing value for " << option << "\n\n";
+                usage();
+                exit(0);
+            }
+
+            bool valid;
+            std::size_t size;
+            if (std::strcmp(option, "--max-time") == 0){
+                char *end;
+                limits.seconds = std::strtod(argv[i], &end);
+                valid = (end != argv[i]) && (*end == '\0') && (limits.seconds > 0);
+            } else{
+                valid = parseSize(argv[i], size);
+                if (std::strcmp(option, "--max-steps") == 0)
+                    limits.steps = size;
+                else if (std::strcmp(option, "--max-depth") == 0)
+                    limits.depth = size;
+                else
+                    limits.memory = size;
+            }
+
+            if (!valid){
+                std::cout << "invalid value for " << option << " (" << argv[i] << ")\n\n";
+                usage();
+                exit(0);
+            }
+        } else if (file == nullptr){
+            file = argv[i];
+        } else{
+            std::cout << "too many arguments\n\n";
+            usage();
+            exit(0);
+        }
+    }
+
+    if (record && replay){
+        std::cout << "--record and --replay can't be used together\n\n";
+        usage();
+        exit(0);
+    }
+
+    if ((record || replay) && (checkpoint || resume)){
+        std::cout << "journals and checkpoints can't be used together\n\n";
+        usage();
+        exit(0);
+    }
+
+    if (batch){
+        if (file){
+            std::cout << "--batch takes the programs from the manifest\n\n";
+            usage();
+            exit(0);
+        }
+
+        Batch::Settings settings;
+        settings.engine = engine;
+        settings.limits = limits;
+        settings.generator = generator;
+        settings.seed = seed;
+        settings.threads = threads;
+
+        Batch runner(settings);
+        if (!runner.load(batch)){
+            std::cout << runner.error();
+            return 2;
+        }
+        return runner.run();
+    }
+
+    if (serve){
+        if (file){
+            std::cout << "--serve takes the programs from its clients\n\n";
+            usage();
+            exit(0);
+        }
+
+        Server::Settings settings;
+        settings.threads = threads;
+        settings.programs = programs;
+
+        Server server(settings);
+        if (server.listen(serve))
+            server.run();
+        std::cout << server.error() << "\n";
+        return 2;
+    }
+
+    if (file == nullptr){
+        std::cout << "error in arguments\n\n";
+        usage();
+        exit(0);
+    }
+
+    // what a server can't do has to run here
+    bool local = debug || emitCpp || image || profile || stats || record || replay || checkpoint || resume;
+    if (connect && local){
+        std::cout << "--connect can't be used with -d, --profile, --stats, journals, checkpoints,\n";
+        std::cout << "--emit-cpp or --compile\n\n";
+        usage();
+        exit(0);
+    }
+
+    // with DSTACK_SERVER set, runs go to that server if it answers
+    const char *socket = connect ? connect : std::getenv("DSTACK_SERVER");
+    if (socket && !local){
+        Connection::Settings remote = {};
+        remote.engine = static_cast<std::uint8_t>(engine);
+        remote.flush = static_cast<std::uint8_t>(flush);
+        remote.generator = static_cast<std::uint8_t>(generator);
+        remote.seed = seed;
+        remote.steps = limits.steps;
+        remote.depth = limits.depth;
+        remote.memory = limits.memory;
+        remote.seconds = limits.seconds;
+
+        Client client(remote);
+        if (client.connect(socket))
+            return client.run(file);
+        if (connect){
+            std::cout << client.error() << "\n";
+            return 2;
+        }
+    }
+
+	Interpreter interpreter{debug};
+	interpreter.setMessages(&std::cout);
+	interpreter.setEngine(engine);
+	interpreter.setFlushPolicy(flush);
+	interpreter.setLimits(limits);
+	interpreter.setRandom(generator, seed);
+	if (mapInput)
+        interpreter.mapInput(); // reads normally if stdin isn't a regular file
+
+    auto loadStart = std::chrono::steady_clock::now();
+	if(!interpreter.load(file))
+		return 2;
+    std::chrono::duration<double> loadTime = std::chrono::steady_clock::now() - loadStart;
+
+    if (emitCpp){
+        interpreter.emitCpp(std::cout);
+        return 0;
+    }
+
+    if (image)
+        return interpreter.compile(image) ? 0 : 2;
+
+    if (profile)
+        interpreter.enableProfile();
+
+    if ((record && !interpreter.record(record)) || (replay && !interpreter.replay(replay)))
+        return 2;
+
+    if (resume && !interpreter.restore(resume))
+        return 2;
+
+    // opening the counters costs a few system calls, only pay them for --stats
+    std::unique_ptr<PerfCounters> counters;
+    auto start = std::chrono::steady_clock::now();
+    if (stats){
+        counters.reset(new PerfCounters);
+        counters->start();
+    }
+
+	bool success;
+    if (checkpoint){
+        auto every = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(checkpointEvery));
+        while ((success = interpreter.run(0, every)) && interpreter.yielded())
+            interpreter.checkpoint(checkpoint);
+        interpreter.finishCheckpoint();
+    } else{
+        success = interpreter.execute();
+    }
+
+    if (stats){
+        counters->stop();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        printStats(interpreter, *counters, loadTime.count(), elapsed.count());
+    }
+
+    if (profile){
+        std::ofstream json(profile);
+        interpreter.writeProfile(std::cerr, json);
+        if (!json)
+            std::cerr << "The profile could not be written (" << profile << ")\n";
+    }
+
+	if(!success)
+		return interpreter.limitReached() ? 4 : 3;
+
+	return 0;
+}
+
+// a number with an optional k, m or g suffix (powers of 1024)
+bool parseSize(const char *text, std::size_t &size){
+    char *end;
+    errno = 0;
+    unsigned long long value = std::strtoull(text, &end, 10);
+    if ((end == text) || (*text == '-') || (errno == ERANGE))
+        return false;
+
+    unsigned int shift = 0;
+    switch (*end){
+        case 'k': case 'K': shift = 10; ++end; break;
+        case 'm': case 'M': shift = 20; ++end; break;
+        case 'g': case 'G': shift = 30; ++end; break;
+    }
+
+    // a size that doesn't fit is as wrong as one that doesn't parse
+    if (value > (std::numeric_limits<std::size_t>::max() >> shift))
+        return false;
+
+    size = static_cast<std::size_t>(value << shift);
+    return (*end == '\0') && (value > 0);
+}
+
+void printStats(const Interpreter &interpreter, const PerfCounters &counters, double loadSeconds, double seconds){
+    Number executed = interpreter.instructionsExecuted();
+
+    auto line = [](const char *name){
+        std::cerr << "    " << name;
+        for (std::size_t i = std::strlen(name); i < 28; ++i)
+            std::cerr << ' ';
+    };
+
+    auto counter = [&](const char *name, PerfCounters::Counter which){
+        line(name);
+        if (counters.available(which))
+            std::cerr << counters.value(which) << "\n";
+        else
+            std::cerr << "n/a\n";
+    };
+
+    auto perInstruction = [&](const char *name, PerfCounters::Counter which){
+        if (counters.available(which) && (executed > 0)){
+            line(name);
+            std::cerr << static_cast<double>(counters.value(which)) / executed << "\n";
+        }
+    };
+
+    std::cerr << "stats:\n";
+    line("load time (s)");
+    std::cerr << loadSeconds << "\n";
+    line("DStack instructions");
+    std::cerr << executed << "\n";
+    line("wall time (s)");
+    std::cerr << seconds << "\n";
+    if (seconds > 0){
+        line("DStack instructions/s");
+        std::cerr << static_cast<Number>(executed / seconds) << "\n";
+    }
+    if (counters.available(PerfCounters::TaskClock)){
+        line("cpu time (s)");
+        std::cerr << counters.value(PerfCounters::TaskClock) / 1e9 << "\n";
+    }
+
+    counter("cycles", PerfCounters::Cycles);
+    counter("instructions", PerfCounters::Instructions);
+    counter("branch misses", PerfCounters::BranchMisses);
+    counter("cache misses", PerfCounters::CacheMisses);
+    perInstruction("cycles/DStack instruction", PerfCounters::Cycles);
+    perInstruction("instructions/DStack instr.", PerfCounters::Instructions);
+    perInstruction("branch misses/DStack instr.", PerfCounters::BranchMisses);
+
+    if (!counters.available(PerfCounters::Cycles))
+        std::cerr << "hardware counters unavailable: " << counters.error() << "\n";
+}
+
+void usage(){
+    std::cout << "dstack [-d] [-e engine] [--flush policy] [--mmap-input] [--profile json] [--stats]\n";
+    std::cout << "       [--seed n] [--random generator] [--record journal | --replay journal]\n";
+    std::cout << "       [--checkpoint file [--checkpoint-every s]] [--resume file] [limits] file\n";
+    std::cout << "dstack --emit-cpp file\n";
+    std::cout << "dstack --compile image file\n";
+    std::cout << "dstack --batch manifest [--jobs n] [-e engine] [--seed n] [--random generator] [limits]\n";
+    std::cout << "dstack --serve socket [--jobs n] [--cache n]\n";
+    std::cout << "dstack --connect socket [-e engine] [--flush policy] [--seed n] [--random generator]\n";
+    std::cout << "       [limits] file\n\n";
+    std::cout << "    -d\tDisplay debugging information while running\n";
+    std::cout << "    -e\tExecution engine: switch (default), threaded, blocks or jit\n";
+    std::cout << "    --flush\tWhen the output is written: line, size (default) or explicit\n";
+    std::cout << "    --mmap-input\tMap the standard input in memory if it is a regular file\n";
+    std::cout << "    --profile\tCount every instruction and jump (switch engine); writes a report\n";
+    std::cout << "             \tto the standard error and the whole profile as JSON to the given file\n";
+    std::cout << "    --stats\tShow instruction counts, timings and hardware counters (Linux) at exit\n";
+    std::cout << "    --seed\tSeed for Rand (by default it changes from run to run)\n";
+    std::cout << "    --random\tGenerator used by Rand: xoshiro (default) or mt19937\n";
+    std::cout << "    --record\tWrite every number read and every random number to a journal\n";
+    std::cout << "    --replay\tTake them from a recorded journal instead, to repeat that run\n";
+    std::cout << "    --checkpoint\tSave the state of the run to a file every so often, in the background\n";
+    std::cout << "    --checkpoint-every\tSeconds between checkpoints (60 by default)\n";
+    std::cout << "    --resume\tGo on from a checkpoint of the same program, with the same input;\n";
+    std::cout << "            \tan output file opened with >> is cut back to what it had then\n";
+    std::cout << "    --emit-cpp\tTranslate the program to C++ and write it to the standard output\n";
+    std::cout << "    --compile\tWrite the parsed program as an image that starts without parsing\n";
+    std::cout << "    --batch\tRun every \"program input [output]\" line of the manifest on a pool of\n";
+    std::cout << "           \tthreads; outputs without a file, and one status line per job on the\n";
+    std::cout << "           \tstandard error, come out in the order of the manifest\n";
+    std::cout << "    --jobs\tThreads used by --batch and --serve (by default one per core)\n";
+    std::cout << "    --serve\tRun programs for the clients of a UNIX domain socket, keeping them\n";
+    std::cout << "           \tparsed for the next time\n";
+    std::cout << "    --cache\tPrograms kept by --serve (64 by default)\n";
+    std::cout << "    --connect\tRun the file on a server, with this standard input and output;\n";
+    std::cout << "             \tsetting DSTACK_SERVER to the socket does it for every run that can\n";
+    std::cout << "             \tuse a server, when there is one\n";
+    std::cout << "    file\tName of the file to be executed (source or image)\n\n";
+    std::cout << "limits (the program stops with exit code 4 when it goes past one):\n";
+    std::cout << "    --max-steps n\tInstructions executed\n";
+    std::cout << "    --max-depth n\tValues in one stack\n";
+    std::cout << "    --max-memory n\tBytes used by the stacks (k, m and g suffixes)\n";
+    std::cout << "    --max-time s\tSeconds of wall-clock time\n\n";
+}